@@ -0,0 +1,23 @@
+#include <algorithm>
+
+#include "ActivationMode.h"
+#include "format.h"
+#include "runtime_assert.h"
+
+namespace gnp
+{
+ActivationMode to_activation_mode(std::string name)
+{
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (name == "record")
+        return ActivationMode::Record;
+    if (name == "frontier")
+        return ActivationMode::Frontier;
+    if (name == "branch_table")
+        return ActivationMode::BranchTable;
+    if (name == "auto")
+        return ActivationMode::Auto;
+    runtime_assert(false, format("'{0}' is invalid activation mode.", name));
+    return ActivationMode::Auto;
+}
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+
+namespace gnp
+{
+// 複数レコードに対するノード遷移の実行方式。
+enum class ActivationMode
+{
+    Record,      // レコードごとに終了までノード遷移を行います。
+    Frontier,    // 全レコードを1ステップずつ進め、現在のノードが同じレコードをまとめて処理します。
+    BranchTable, // 到達可能な判定ノードごとに全レコードのブランチを先に求め、表を引きながらノード遷移を行います。
+    Auto         // 個体とレコード数から自動的に選択します。
+};
+
+// 文字列("record", "frontier", "branch_table", "auto")から実行方式を求めます。
+ActivationMode to_activation_mode(std::string name);
+}
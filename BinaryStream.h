@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "runtime_assert.h"
+
+namespace gnp
+{
+// 値をそのままのバイト列として buffer の末尾に書き込みます(プロセス間で個体を受け渡すための形式です)。
+class BinaryWriter
+{
+  public:
+    explicit BinaryWriter(std::vector<char> &buffer) : buffer(buffer) {}
+
+    template <typename T>
+    void write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "");
+        auto size = this->buffer.size();
+        this->buffer.resize(size + sizeof(T));
+        std::memcpy(this->buffer.data() + size, &value, sizeof(T));
+    }
+
+  private:
+    std::vector<char> &buffer;
+};
+
+// BinaryWriter で書き込んだバイト列を先頭から読み込みます。
+class BinaryReader
+{
+  public:
+    BinaryReader(const char *begin, const char *end) : cursor(begin), end(end) {}
+
+    template <typename T>
+    T read()
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "");
+        runtime_assert(sizeof(T) <= static_cast<size_t>(this->end - this->cursor), "Binary data is truncated.");
+        T value;
+        std::memcpy(&value, this->cursor, sizeof(T));
+        this->cursor += sizeof(T);
+        return value;
+    }
+
+    // すべて読み込んだかどうかを取得します。
+    bool at_end() const
+    {
+        return this->cursor == this->end;
+    }
+
+  private:
+    const char *cursor;
+    const char *end;
+};
+}
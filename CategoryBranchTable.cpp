@@ -0,0 +1,108 @@
+#include <algorithm>
+
+#include "CategoryBranchTable.h"
+#include "assert.h"
+
+namespace gnp
+{
+static inline size_t hash_category(category_t category)
+{
+    // (splitmix64 の最終段。連続したカテゴリでも偏りなく分散させます。)
+    auto x = static_cast<uint64_t>(category);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<size_t>(x ^ (x >> 31));
+}
+
+void CategoryBranchTable::set(category_t category, int index)
+{
+    assert(0 <= index, "Index must be greater than or equal to 0.");
+    if (0 <= category && category < dense_limit)
+    {
+        if (static_cast<category_t>(this->dense.size()) <= category)
+            this->dense.resize(category + 1, -1);
+        if (this->dense[category] < 0)
+            this->count++;
+        this->dense[category] = index;
+        return;
+    }
+
+    // 負荷率が 1/2 を超えないように拡張します。
+    if (this->sparse.size() < 2 * (this->sparse_count + 1))
+        this->rehash(std::max<size_t>(16, 2 * this->sparse.size()));
+    auto mask = this->sparse.size() - 1;
+    for (auto slot = hash_category(category) & mask;; slot = (slot + 1) & mask)
+    {
+        auto &entry = this->sparse[slot];
+        if (entry.second < 0)
+        {
+            entry = std::make_pair(category, index);
+            this->sparse_count++;
+            this->count++;
+            return;
+        }
+        if (entry.first == category)
+        {
+            entry.second = index;
+            return;
+        }
+    }
+}
+
+void CategoryBranchTable::clear()
+{
+    this->dense.clear();
+    std::fill(this->sparse.begin(), this->sparse.end(), std::make_pair(category_t(0), -1));
+    this->sparse_count = 0;
+    this->count = 0;
+}
+
+std::vector<std::pair<category_t, int>> CategoryBranchTable::items() const
+{
+    std::vector<std::pair<category_t, int>> items;
+    items.reserve(this->count);
+    for (category_t category = 0; category < static_cast<category_t>(this->dense.size()); category++)
+    {
+        if (0 <= this->dense[category])
+            items.emplace_back(category, this->dense[category]);
+    }
+    for (auto &entry : this->sparse)
+    {
+        if (0 <= entry.second)
+            items.push_back(entry);
+    }
+    std::sort(items.begin(), items.end());
+    return items;
+}
+
+bool CategoryBranchTable::operator==(const CategoryBranchTable &other) const
+{
+    return this->count == other.count && this->items() == other.items();
+}
+
+int CategoryBranchTable::find(category_t category) const
+{
+    auto mask = this->sparse.size() - 1;
+    for (auto slot = hash_category(category) & mask;; slot = (slot + 1) & mask)
+    {
+        auto &entry = this->sparse[slot];
+        if (entry.second < 0)
+            return -1;
+        if (entry.first == category)
+            return entry.second;
+    }
+}
+
+void CategoryBranchTable::rehash(size_t capacity)
+{
+    auto entries = std::move(this->sparse);
+    this->sparse.assign(capacity, std::make_pair(category_t(0), -1));
+    this->count -= this->sparse_count;
+    this->sparse_count = 0;
+    for (auto &entry : entries)
+    {
+        if (0 <= entry.second)
+            this->set(entry.first, entry.second);
+    }
+}
+}
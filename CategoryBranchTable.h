@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "GNPTypes.h"
+
+namespace gnp
+{
+// カテゴリからブランチのインデックスへの変換表です。
+// 0 以上 dense_limit 未満のカテゴリは密な配列に格納し、1 回の添字アクセスで参照します。
+// それ以外のカテゴリ(カテゴリ数が非常に多い属性)はオープンアドレス法のハッシュ表に格納します。
+class CategoryBranchTable
+{
+  public:
+    // 密な配列に格納するカテゴリの上限値(この値未満のカテゴリが対象です)。
+    static constexpr category_t dense_limit = 1 << 16;
+
+    // カテゴリに対応するブランチのインデックスを取得します(存在しない場合は std::out_of_range を送出します)。
+    int at(category_t category) const
+    {
+        auto index = this->get(category);
+        if (index < 0)
+            throw std::out_of_range("Category is not found in branches.");
+        return index;
+    }
+
+    // カテゴリに対応するブランチのインデックスを取得します(存在しない場合は -1 を返します)。
+    int get(category_t category) const
+    {
+        if (0 <= category && category < static_cast<category_t>(this->dense.size()))
+            return this->dense[category];
+        else if (!this->sparse.empty())
+            return this->find(category);
+        return -1;
+    }
+
+    // カテゴリに対応するブランチのインデックスを設定します。
+    void set(category_t category, int index);
+
+    // 全ての対応付けを削除します(確保済みの領域は再利用されます)。
+    void clear();
+
+    // 対応付けの数を取得します。
+    int size() const
+    {
+        return this->count;
+    }
+
+    // 全ての対応付けをカテゴリの昇順に取得します。
+    std::vector<std::pair<category_t, int>> items() const;
+
+    bool operator==(const CategoryBranchTable &other) const;
+
+    bool operator!=(const CategoryBranchTable &other) const
+    {
+        return !(*this == other);
+    }
+
+  private:
+    int find(category_t category) const;
+
+    void rehash(size_t capacity);
+
+  private:
+    // 密な配列(対応するブランチがない場合は -1)。
+    std::vector<int> dense;
+
+    // ハッシュ表(容量は 2 のべき乗、空きは値が -1)。
+    std::vector<std::pair<category_t, int>> sparse;
+
+    // ハッシュ表に格納されている対応付けの数。
+    int sparse_count = 0;
+
+    // 対応付けの総数。
+    int count = 0;
+};
+}
@@ -0,0 +1,605 @@
+#include <algorithm>
+#include <stdexcept>
+#include <typeinfo>
+#include <utility>
+
+#include "CompiledGenome.h"
+#include "Conversion.h"
+#include "ScopedGILRelease.h"
+#include "ThreadPool.h"
+#include "ThresholdSearch.h"
+#include "assert.h"
+#include "runtime_assert.h"
+
+namespace gnp
+{
+// 設定から決まるノードの実行時間を取得します。
+static double gene_delay(const AbstractNodeGene &gene, const GNPConfig &config)
+{
+    if (typeid(gene) == typeid(InitialNodeGene))
+        return 0.0;
+    if (typeid(gene) == typeid(ProcessingNodeGene))
+        return config.delay_time_processing_node;
+    return config.delay_time_judgement_node;
+}
+
+CompiledGenome::CompiledGenome(const Genome &genome, const GNPConfig &config)
+{
+    auto num_nodes = genome.genes.size();
+    this->kinds.reserve(num_nodes);
+    this->delays.reserve(num_nodes);
+    this->sources.reserve(num_nodes);
+    this->target_offsets.reserve(num_nodes + 1);
+    this->parameter_offsets.reserve(num_nodes + 1);
+
+    // 出力の領域は設定のノードの実行時間から確保するため、実行時間が設定と異なる個体は受け付けません。
+    for (auto &gene : genome.genes)
+    {
+        assert(gene->index == this->kinds.size(), "Index is not matched.");
+        runtime_assert(gene->delay == gene_delay(*gene, config), "Node delay does not match the config.");
+        this->target_offsets.push_back(this->targets.size());
+        this->parameter_offsets.push_back(this->parameters.size());
+        this->delays.push_back(gene->delay);
+
+        if (auto node = dynamic_cast<const InitialNodeGene *>(gene.get()))
+        {
+            this->kinds.push_back(NodeKind::Initial);
+            this->sources.push_back(-1);
+            this->targets.push_back(node->target);
+        }
+        else if (auto node = dynamic_cast<const ProcessingNodeGene *>(gene.get()))
+        {
+            runtime_assert(node->value.size() == config.output_attributes.size(), "Output size is not matched.");
+            this->kinds.push_back(NodeKind::Processing);
+            this->sources.push_back(-1);
+            this->targets.push_back(node->target);
+            this->parameters.insert(this->parameters.end(), node->value.data(), node->value.data() + node->value.size());
+        }
+        else if (auto node = dynamic_cast<const CategoryJudgementNodeGene *>(gene.get()))
+        {
+            this->sources.push_back(node->source);
+            this->targets.insert(this->targets.end(), node->targets.begin(), node->targets.end());
+
+            // カテゴリの最大値までの密な表を作成します(カテゴリの最小値は常に 0 です)。
+            // 密な表が大きくなりすぎる場合は、変換表をそのまま保持します。
+            auto items = node->branches.items();
+            auto max = config.input_attributes[node->source].max.category;
+            auto sparse = !items.empty() && items.front().first < 0;
+            for (auto &pair : items)
+                max = std::max(max, pair.first);
+            if (sparse || CategoryBranchTable::dense_limit <= max)
+            {
+                data_t parameter;
+                parameter.category = this->sparse_tables.size();
+                this->kinds.push_back(NodeKind::SparseCategoryJudgement);
+                this->parameters.push_back(parameter);
+                this->sparse_tables.push_back(node->branches);
+            }
+            else
+            {
+                auto begin = this->parameters.size();
+                this->kinds.push_back(NodeKind::CategoryJudgement);
+                this->parameters.resize(begin + max + 1, data_t{0});
+                for (auto it = this->parameters.begin() + begin; it != this->parameters.end(); it++)
+                    it->category = -1;
+                for (auto &pair : items)
+                    this->parameters[begin + pair.first].category = pair.second;
+            }
+        }
+        else if (auto node = dynamic_cast<const NumericJudgementNodeGene *>(gene.get()))
+        {
+            this->kinds.push_back(NodeKind::NumericJudgement);
+            this->sources.push_back(node->source);
+            this->targets.insert(this->targets.end(), node->targets.begin(), node->targets.end());
+            for (auto threshold : node->thresholds)
+            {
+                data_t parameter;
+                parameter.numeric = threshold;
+                this->parameters.push_back(parameter);
+            }
+        }
+        else
+        {
+            runtime_assert(false, "Unknown node gene.");
+        }
+    }
+    this->target_offsets.push_back(this->targets.size());
+    this->parameter_offsets.push_back(this->parameters.size());
+
+    // 制限時間内に実行される判定ノードを列挙します。
+    auto reachable = genome.reachable_genes(config);
+    auto supported = true;
+    this->table_indices.assign(num_nodes, -1);
+    for (int node = 0; node < num_nodes; node++)
+    {
+        auto kind = this->kinds[node];
+        if (reachable[node] && kind != NodeKind::Initial && kind != NodeKind::Processing)
+        {
+            supported = supported && this->target_offsets[node + 1] - this->target_offsets[node] <= missing_branch;
+            this->table_indices[node] = this->table_nodes.size();
+            this->table_nodes.push_back(node);
+        }
+    }
+    if (!supported)
+    {
+        this->table_nodes.clear();
+        this->table_indices.assign(num_nodes, -1);
+    }
+}
+
+int CompiledGenome::judge(int node, const data_t *record) const
+{
+    const auto *parameters = this->parameters.data() + this->parameter_offsets[node];
+    auto size = this->parameter_offsets[node + 1] - this->parameter_offsets[node];
+    switch (this->kinds[node])
+    {
+    case NodeKind::CategoryJudgement:
+    {
+        auto value = record[this->sources[node]].category;
+        if (value < 0 || size <= value || parameters[value].category < 0)
+            throw std::out_of_range("Category is not found in branches.");
+        return static_cast<int>(parameters[value].category);
+    }
+    case NodeKind::SparseCategoryJudgement:
+        return this->sparse_tables[parameters[0].category].at(record[this->sources[node]].category);
+    case NodeKind::NumericJudgement:
+        return search_branch(parameters, size, record[this->sources[node]].numeric);
+    default:
+        return 0;
+    }
+}
+
+Matrix<data_t> CompiledGenome::activate(const Vector<data_t> &vector, const GNPConfig &config) const
+{
+    thread_local std::vector<data_t> buffer;
+    auto cols = config.output_attributes.size();
+    buffer.resize(config.max_num_outputs() * cols);
+
+    auto rows = this->activate(vector.data(), config, buffer.data());
+    Matrix<data_t> outputs(rows, cols);
+    std::copy(buffer.begin(), buffer.begin() + rows * cols, outputs.data());
+    return outputs;
+}
+
+int CompiledGenome::activate(const data_t *record, const GNPConfig &config, data_t *outputs) const
+{
+    auto remaining_time = config.time_limit;
+    auto current = 0;
+    auto cols = static_cast<int>(config.output_attributes.size());
+    auto capacity = config.max_num_outputs();
+    auto rows = 0;
+
+    const auto *kinds = this->kinds.data();
+    const auto *delays = this->delays.data();
+    const auto *target_offsets = this->target_offsets.data();
+    const auto *targets = this->targets.data();
+    const auto *parameter_offsets = this->parameter_offsets.data();
+    const auto *parameters = this->parameters.data();
+
+    while (0 < remaining_time)
+    {
+        auto branch = 0;
+        switch (kinds[current])
+        {
+        case NodeKind::Initial:
+            break;
+        case NodeKind::Processing:
+        {
+            // (コンパイル時と異なる設定で実行された場合に備え、リリースビルドでも確認します。)
+            if (capacity <= rows)
+                runtime_assert(false, "Number of outputs exceeds the capacity.");
+            auto begin = parameters + parameter_offsets[current];
+            std::copy(begin, begin + cols, outputs + rows * cols);
+            rows++;
+            break;
+        }
+        default:
+            branch = this->judge(current, record);
+            break;
+        }
+        assert(branch < target_offsets[current + 1] - target_offsets[current], "Index is out of range.");
+        remaining_time -= delays[current];
+        current = targets[target_offsets[current] + branch];
+        assert(current < this->num_nodes(), "Index is out of range.");
+    }
+    return rows;
+}
+
+void CompiledGenome::activate_frontier(const data_t *records, int num_records, int stride, const GNPConfig &config, data_t *outputs, int *counts, std::uint64_t *visits, int visit_words) const
+{
+    auto num_nodes = this->num_nodes();
+    auto cols = static_cast<int>(config.output_attributes.size());
+    auto capacity = config.max_num_outputs();
+    auto record_outputs = capacity * cols;
+
+    const auto *kinds = this->kinds.data();
+    const auto *delays = this->delays.data();
+    const auto *sources = this->sources.data();
+    const auto *target_offsets = this->target_offsets.data();
+    const auto *targets = this->targets.data();
+    const auto *parameter_offsets = this->parameter_offsets.data();
+    const auto *parameters = this->parameters.data();
+
+    // 各レコードの現在のノードと残り時間。
+    thread_local std::vector<int> nodes;
+    thread_local std::vector<double> remaining_times;
+    // 遷移中のレコード、現在のノードごとに並べ替えたレコード、各ノードのレコードの終了位置。
+    thread_local std::vector<int> active;
+    thread_local std::vector<int> sorted;
+    thread_local std::vector<int> offsets;
+    nodes.assign(num_records, 0);
+    remaining_times.assign(num_records, config.time_limit);
+    sorted.resize(num_records);
+    offsets.resize(num_nodes);
+    std::fill(counts, counts + num_records, 0);
+
+    active.clear();
+    if (0 < config.time_limit)
+    {
+        for (int i = 0; i < num_records; i++)
+            active.push_back(i);
+    }
+
+    while (!active.empty())
+    {
+        // 現在のノードごとにレコードを並べ替えます(計数ソート)。
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (auto i : active)
+            offsets[nodes[i]]++;
+        for (int node = 1; node < num_nodes; node++)
+            offsets[node] += offsets[node - 1];
+        for (auto it = active.rbegin(); it != active.rend(); it++)
+            sorted[--offsets[nodes[*it]]] = *it;
+        auto num_active = static_cast<int>(active.size());
+        active.clear();
+
+        // ノードごとに、待機しているレコードをまとめて1ステップ進めます。
+        for (int node = 0; node < num_nodes; node++)
+        {
+            auto begin = offsets[node];
+            auto end = node + 1 < num_nodes ? offsets[node + 1] : num_active;
+            if (begin == end)
+                continue;
+            if (visits)
+            {
+                auto *node_visits = visits + static_cast<size_t>(node) * visit_words;
+                for (int k = begin; k < end; k++)
+                    node_visits[sorted[k] >> 6] |= std::uint64_t(1) << (sorted[k] & 63);
+            }
+
+            auto delay = delays[node];
+            const auto *node_targets = targets + target_offsets[node];
+            const auto *node_parameters = parameters + parameter_offsets[node];
+            auto num_parameters = parameter_offsets[node + 1] - parameter_offsets[node];
+            auto source = sources[node];
+            auto advance = [&](int i, int branch) {
+                assert(branch < target_offsets[node + 1] - target_offsets[node], "Index is out of range.");
+                nodes[i] = node_targets[branch];
+                remaining_times[i] -= delay;
+                if (0 < remaining_times[i])
+                    active.push_back(i);
+            };
+
+            switch (kinds[node])
+            {
+            case NodeKind::Initial:
+                for (int k = begin; k < end; k++)
+                    advance(sorted[k], 0);
+                break;
+            case NodeKind::Processing:
+                for (int k = begin; k < end; k++)
+                {
+                    auto i = sorted[k];
+                    if (capacity <= counts[i])
+                        runtime_assert(false, "Number of outputs exceeds the capacity.");
+                    std::copy(node_parameters, node_parameters + cols, outputs + i * record_outputs + counts[i] * cols);
+                    counts[i]++;
+                    advance(i, 0);
+                }
+                break;
+            case NodeKind::CategoryJudgement:
+                for (int k = begin; k < end; k++)
+                {
+                    auto i = sorted[k];
+                    auto value = records[i * stride + source].category;
+                    if (value < 0 || num_parameters <= value || node_parameters[value].category < 0)
+                        throw std::out_of_range("Category is not found in branches.");
+                    advance(i, static_cast<int>(node_parameters[value].category));
+                }
+                break;
+            case NodeKind::SparseCategoryJudgement:
+            {
+                auto &table = this->sparse_tables[node_parameters[0].category];
+                for (int k = begin; k < end; k++)
+                {
+                    auto i = sorted[k];
+                    advance(i, table.at(records[i * stride + source].category));
+                }
+                break;
+            }
+            case NodeKind::NumericJudgement:
+                for (int k = begin; k < end; k++)
+                {
+                    auto i = sorted[k];
+                    advance(i, search_branch(node_parameters, num_parameters, records[i * stride + source].numeric));
+                }
+                break;
+            }
+        }
+    }
+}
+
+void CompiledGenome::compute_branch_table(int node, const data_t *records, int num_records, int stride, uint8_t *table) const
+{
+    thread_local std::vector<numeric_t> column;
+    thread_local std::vector<category_t> branches;
+
+    auto source = this->sources[node];
+    const auto *parameters = this->parameters.data() + this->parameter_offsets[node];
+    auto size = this->parameter_offsets[node + 1] - this->parameter_offsets[node];
+    switch (this->kinds[node])
+    {
+    case NodeKind::NumericJudgement:
+        column.resize(num_records);
+        branches.resize(num_records);
+        for (int i = 0; i < num_records; i++)
+            column[i] = records[i * stride + source].numeric;
+        search_branches(parameters, size, column.data(), num_records, branches.data());
+        for (int i = 0; i < num_records; i++)
+            table[i] = static_cast<uint8_t>(branches[i]);
+        break;
+    case NodeKind::CategoryJudgement:
+        // (対応するブランチがないカテゴリは、実際に判定ノードを訪れた時点で例外を送出します。)
+        for (int i = 0; i < num_records; i++)
+        {
+            auto value = records[i * stride + source].category;
+            auto branch = 0 <= value && value < size ? parameters[value].category : -1;
+            table[i] = branch < 0 ? missing_branch : static_cast<uint8_t>(branch);
+        }
+        break;
+    case NodeKind::SparseCategoryJudgement:
+    {
+        auto &sparse_table = this->sparse_tables[parameters[0].category];
+        for (int i = 0; i < num_records; i++)
+        {
+            auto branch = sparse_table.get(records[i * stride + source].category);
+            table[i] = branch < 0 ? missing_branch : static_cast<uint8_t>(branch);
+        }
+        break;
+    }
+    default:
+        std::fill(table, table + num_records, 0);
+        break;
+    }
+}
+
+std::string CompiledGenome::judgement_signature(int node) const
+{
+    auto kind = this->kinds[node];
+    auto source = this->sources[node];
+    std::string signature;
+    signature.append(reinterpret_cast<const char *>(&kind), sizeof(kind));
+    signature.append(reinterpret_cast<const char *>(&source), sizeof(source));
+    if (kind == NodeKind::SparseCategoryJudgement)
+    {
+        auto &sparse_table = this->sparse_tables[this->parameters[this->parameter_offsets[node]].category];
+        for (auto &pair : sparse_table.items())
+        {
+            signature.append(reinterpret_cast<const char *>(&pair.first), sizeof(pair.first));
+            signature.append(reinterpret_cast<const char *>(&pair.second), sizeof(pair.second));
+        }
+    }
+    else
+    {
+        auto begin = this->parameters.data() + this->parameter_offsets[node];
+        auto end = this->parameters.data() + this->parameter_offsets[node + 1];
+        signature.append(reinterpret_cast<const char *>(begin), reinterpret_cast<const char *>(end));
+    }
+    return signature;
+}
+
+void CompiledGenome::activate_branch_table(const data_t *records, int num_records, int stride, const GNPConfig &config, data_t *outputs, int *counts) const
+{
+    if (this->table_nodes.empty())
+    {
+        this->activate_frontier(records, num_records, stride, config, outputs, counts);
+        return;
+    }
+
+    // 到達可能な判定ノードごとに、全レコードのブランチを求めます(ノード優先の配置)。
+    thread_local std::vector<uint8_t> buffer;
+    thread_local std::vector<const uint8_t *> tables;
+    buffer.resize(this->table_nodes.size() * num_records);
+    tables.resize(this->table_nodes.size());
+    for (int t = 0; t < this->table_nodes.size(); t++)
+    {
+        this->compute_branch_table(this->table_nodes[t], records, num_records, stride, buffer.data() + t * num_records);
+        tables[t] = buffer.data() + t * num_records;
+    }
+    this->activate_tables(tables.data(), 0, records, num_records, stride, config, outputs, counts);
+}
+
+void CompiledGenome::activate_tables(const uint8_t *const *tables, int first, const data_t *records, int num_records, int stride, const GNPConfig &config, data_t *outputs, int *counts) const
+{
+    auto cols = static_cast<int>(config.output_attributes.size());
+    auto capacity = config.max_num_outputs();
+    auto record_outputs = capacity * cols;
+
+    // ブランチの表を引きながら、レコードごとにノード遷移を行います。
+    const auto *kinds = this->kinds.data();
+    const auto *delays = this->delays.data();
+    const auto *target_offsets = this->target_offsets.data();
+    const auto *targets = this->targets.data();
+    const auto *parameter_offsets = this->parameter_offsets.data();
+    const auto *parameters = this->parameters.data();
+    const auto *table_indices = this->table_indices.data();
+    for (int i = 0; i < num_records; i++)
+    {
+        auto remaining_time = config.time_limit;
+        auto current = 0;
+        auto rows = 0;
+        auto *record_output = outputs + i * record_outputs;
+        while (0 < remaining_time)
+        {
+            auto branch = 0;
+            switch (kinds[current])
+            {
+            case NodeKind::Initial:
+                break;
+            case NodeKind::Processing:
+            {
+                if (capacity <= rows)
+                    runtime_assert(false, "Number of outputs exceeds the capacity.");
+                auto begin = parameters + parameter_offsets[current];
+                std::copy(begin, begin + cols, record_output + rows * cols);
+                rows++;
+                break;
+            }
+            default:
+            {
+                // (経過時間の誤差で表のないノードに到達した場合は、直接ブランチを求めます。)
+                auto t = table_indices[current];
+                branch = 0 <= t ? tables[t][first + i] : this->judge(current, records + i * stride);
+                if (branch == missing_branch)
+                    throw std::out_of_range("Category is not found in branches.");
+                break;
+            }
+            }
+            assert(branch < target_offsets[current + 1] - target_offsets[current], "Index is out of range.");
+            remaining_time -= delays[current];
+            current = targets[target_offsets[current] + branch];
+        }
+        counts[i] = rows;
+    }
+}
+
+void CompiledGenome::activate_many(ActivationMode mode, const data_t *records, int num_records, int stride, const GNPConfig &config, data_t *outputs, int *counts) const
+{
+    auto record_outputs = config.max_num_outputs() * static_cast<int>(config.output_attributes.size());
+    switch (mode)
+    {
+    case ActivationMode::Record:
+        for (int i = 0; i < num_records; i++)
+            counts[i] = this->activate(records + i * stride, config, outputs + i * record_outputs);
+        break;
+    case ActivationMode::Frontier:
+        this->activate_frontier(records, num_records, stride, config, outputs, counts);
+        break;
+    case ActivationMode::BranchTable:
+        this->activate_branch_table(records, num_records, stride, config, outputs, counts);
+        break;
+    case ActivationMode::Auto:
+        this->activate_many(this->select_mode(records, num_records, stride, config), records, num_records, stride, config, outputs, counts);
+        break;
+    }
+}
+
+int CompiledGenome::count_judgements(const data_t *record, const GNPConfig &config) const
+{
+    auto remaining_time = config.time_limit;
+    auto current = 0;
+    auto count = 0;
+    while (0 < remaining_time)
+    {
+        auto branch = 0;
+        if (this->kinds[current] != NodeKind::Initial && this->kinds[current] != NodeKind::Processing)
+        {
+            branch = this->judge(current, record);
+            count++;
+        }
+        remaining_time -= this->delays[current];
+        current = this->targets[this->target_offsets[current] + branch];
+    }
+    return count;
+}
+
+ActivationMode CompiledGenome::select_mode(const data_t *records, int num_records, int stride, const GNPConfig &config) const
+{
+    // 到達可能な判定ノードの1レコードあたりの平均訪問回数が1を超える場合は、
+    // 全レコードのブランチを先に求めておく方が判定の回数が少なくなります。
+    if (!this->table_nodes.empty() && 0 < num_records)
+    {
+        auto num_samples = std::min(num_records, num_sample_records);
+        auto visits = 0LL;
+        for (int k = 0; k < num_samples; k++)
+        {
+            auto i = static_cast<long long>(k) * num_records / num_samples;
+            visits += this->count_judgements(records + i * stride, config);
+        }
+        if (static_cast<long long>(this->table_nodes.size()) * num_samples < visits)
+            return ActivationMode::BranchTable;
+    }
+    return min_frontier_records <= num_records ? ActivationMode::Frontier : ActivationMode::Record;
+}
+
+std::vector<Matrix<data_t>> CompiledGenome::activate_batch(const Matrix<data_t> &matrix, const GNPConfig &config, ActivationMode mode) const
+{
+    auto rows = static_cast<int>(matrix.rows());
+    auto cols = static_cast<int>(config.output_attributes.size());
+    auto stride = static_cast<int>(matrix.cols());
+    auto outputs = std::vector<Matrix<data_t>>(rows);
+    if (mode == ActivationMode::Auto)
+        mode = this->select_mode(matrix.data(), rows, stride, config);
+
+    auto record_outputs = config.max_num_outputs() * cols;
+    auto num_chunks = (rows + chunk_size - 1) / chunk_size;
+
+    // (個体ごとの並列処理の中から呼び出された場合も、同じスレッドプールで区間を分担します。)
+    auto threads = ThreadPool::instance(config.num_threads);
+    auto buffers = std::vector<std::vector<data_t>>(threads->size());
+    auto counts = std::vector<std::vector<int>>(threads->size());
+    threads->parallel_for(0, num_chunks, [&](int chunk, int worker) {
+        auto &buffer = buffers[worker];
+        auto &count = counts[worker];
+        buffer.resize(std::min(chunk_size, rows) * record_outputs);
+        count.resize(std::min(chunk_size, rows));
+        auto begin = chunk * chunk_size;
+        auto size = std::min(chunk_size, rows - begin);
+        this->activate_many(mode, matrix.data() + begin * stride, size, stride, config, buffer.data(), count.data());
+        for (int i = 0; i < size; i++)
+        {
+            auto first = buffer.begin() + i * record_outputs;
+            outputs[begin + i].resize(count[i], cols);
+            std::copy(first, first + count[i] * cols, outputs[begin + i].data());
+        }
+    });
+    return outputs;
+}
+
+boost::python::numpy::ndarray CompiledGenome::activate_py(boost::python::numpy::ndarray vector_py, const GNPConfig &config) const
+{
+    auto input = pyvec2cppvec(config.input_attributes, vector_py);
+    auto output = cppmat2pymat(config.output_attributes, this->activate(input, config));
+    return output;
+}
+
+int CompiledGenome::activate_into_py(boost::python::numpy::ndarray vector_py, const GNPConfig &config, boost::python::numpy::ndarray out) const
+{
+    thread_local std::vector<data_t> input;
+    thread_local std::vector<data_t> output;
+    input.resize(config.input_attributes.size());
+    output.resize(config.max_num_outputs() * config.output_attributes.size());
+
+    pyvec2cppvec(config.input_attributes, vector_py, input.data());
+    auto rows = this->activate(input.data(), config, output.data());
+    cppbuf2pymat(config.output_attributes, output.data(), rows, out);
+    return rows;
+}
+
+boost::python::numpy::ndarray CompiledGenome::activate_batch_py(boost::python::numpy::ndarray matrix_py, const GNPConfig &config, const std::string &mode) const
+{
+    return this->activate_batch_py(Dataset(matrix_py, config.input_attributes), config, mode);
+}
+
+boost::python::numpy::ndarray CompiledGenome::activate_batch_py(const Dataset &dataset, const GNPConfig &config, const std::string &mode) const
+{
+    dataset.validate(config, false);
+    auto activation_mode = to_activation_mode(mode);
+    std::vector<Matrix<data_t>> outputs;
+    {
+        ScopedGILRelease release;
+        outputs = this->activate_batch(dataset.inputs, config, activation_mode);
+    }
+    return cppbatch2pyarray(config.output_attributes, outputs);
+}
+}
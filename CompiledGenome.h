@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+
+#include "ActivationMode.h"
+#include "CategoryBranchTable.h"
+#include "Dataset.h"
+#include "GNPConfig.h"
+#include "GNPTypes.h"
+#include "Genome.h"
+
+namespace gnp
+{
+// ノードの種類。
+enum class NodeKind : uint8_t
+{
+    Initial,           // 遷移開始ノード。
+    Processing,        // 処理ノード。
+    CategoryJudgement,       // カテゴリ属性の判定ノード。
+    NumericJudgement,        // 数値属性の判定ノード。
+    SparseCategoryJudgement  // カテゴリ数が非常に多いカテゴリ属性の判定ノード(CompiledGenome のみ)。
+};
+
+// ノード遷移専用に Genome を平坦化した表現です。
+// 各ノードの情報をインデックスで参照される連続した配列(struct of arrays)に格納し、
+// 仮想関数呼び出しやポインタの追跡なしにノード遷移を行います。
+// (元の Genome が変更された場合は作り直す必要があります。)
+class CompiledGenome
+{
+  public:
+    CompiledGenome() = default;
+
+    // Genome から新規に CompiledGenome を作成します。
+    CompiledGenome(const Genome &genome, const GNPConfig &config);
+
+    // ノード遷移を行います。
+    Matrix<data_t> activate(const Vector<data_t> &vector, const GNPConfig &config) const;
+
+    // ノード遷移を行い、出力値を outputs に行優先で書き込みます。戻り値は出力した回数(行数)です。
+    // outputs には config.max_num_outputs() * 出力属性数 個の領域が必要です(ヒープ領域の確保は行いません)。
+    int activate(const data_t *record, const GNPConfig &config, data_t *outputs) const;
+
+    // 複数のレコードに対してフロンティア方式でノード遷移を行います。
+    // records は1レコードあたり stride 個の要素を持つ行優先の配列です。
+    // レコード i の出力値は outputs + i * config.max_num_outputs() * 出力属性数 から書き込まれ、出力した回数は counts[i] に格納されます。
+    // visits を指定した場合は、ノード n を実行したレコード i について visits[n * visit_words + i / 64] の i % 64 ビット目を立てます。
+    void activate_frontier(const data_t *records, int num_records, int stride, const GNPConfig &config, data_t *outputs, int *counts, std::uint64_t *visits = nullptr, int visit_words = 0) const;
+
+    // 到達可能な判定ノードごとに全レコードのブランチを先に求めてから、表を引きながらノード遷移を行います。
+    // 引数は activate_frontier と同じです(表を作成できない個体では activate_frontier と同じ処理を行います)。
+    void activate_branch_table(const data_t *records, int num_records, int stride, const GNPConfig &config, data_t *outputs, int *counts) const;
+
+    // 作成済みのブランチの表を使って、複数のレコードに対してノード遷移を行います。
+    // tables[t] は table_nodes[t] の表で、records の先頭のレコードは表の first 番目に対応します(その他の引数は activate_frontier と同じです)。
+    void activate_tables(const uint8_t *const *tables, int first, const data_t *records, int num_records, int stride, const GNPConfig &config, data_t *outputs, int *counts) const;
+
+    // 判定ノード node について、各レコードのブランチのインデックスを table に格納します(対応するブランチがない場合は missing_branch)。
+    void compute_branch_table(int node, const data_t *records, int num_records, int stride, uint8_t *table) const;
+
+    // 判定ノード node の種類、入力元、パラメータを連結したバイト列を取得します(値が同じノードは同じブランチを選択します)。
+    std::string judgement_signature(int node) const;
+
+    // 指定された方式で、複数のレコードに対してノード遷移を行います(引数は activate_frontier と同じです)。
+    void activate_many(ActivationMode mode, const data_t *records, int num_records, int stride, const GNPConfig &config, data_t *outputs, int *counts) const;
+
+    // 個体の構造とレコードの一部から、実行方式を選択します(戻り値は Auto 以外です)。
+    ActivationMode select_mode(const data_t *records, int num_records, int stride, const GNPConfig &config) const;
+
+    // 全レコード(行)に対してノード遷移を行います。
+    std::vector<Matrix<data_t>> activate_batch(const Matrix<data_t> &matrix, const GNPConfig &config, ActivationMode mode = ActivationMode::Auto) const;
+
+    // ノード遷移を行います。
+    boost::python::numpy::ndarray activate_py(boost::python::numpy::ndarray vector, const GNPConfig &config) const;
+
+    // ノード遷移を行い、出力値を out (float64, 形状は (config.max_num_outputs, 出力属性数)) に書き込みます。
+    // 戻り値は出力した回数(行数)です。
+    int activate_into_py(boost::python::numpy::ndarray vector, const GNPConfig &config, boost::python::numpy::ndarray out) const;
+
+    // 全レコード(行)に対してノード遷移を行います。
+    boost::python::numpy::ndarray activate_batch_py(boost::python::numpy::ndarray matrix, const GNPConfig &config, const std::string &mode) const;
+
+    // データセットの全レコードに対してノード遷移を行います。
+    boost::python::numpy::ndarray activate_batch_py(const Dataset &dataset, const GNPConfig &config, const std::string &mode) const;
+
+    int num_nodes() const
+    {
+        return static_cast<int>(this->kinds.size());
+    }
+
+    // 実行方式が Auto の場合に、フロンティア方式を選択する最小のレコード数。
+    static constexpr int min_frontier_records = 64;
+
+    // 実行方式が Auto の場合に、判定ノードの訪問回数を調べるレコード数。
+    static constexpr int num_sample_records = 32;
+
+    // 複数のレコードに対してノード遷移を行う場合に、一度に処理するレコード数。
+    static constexpr int chunk_size = 256;
+
+    // ブランチの表において、対応するブランチがないことを表す値。
+    static constexpr uint8_t missing_branch = 0xff;
+
+  private:
+    // 判定ノードのブランチのインデックスを求めます。
+    int judge(int node, const data_t *record) const;
+
+    // ノード遷移を行い、判定ノードを実行した回数を返します。
+    int count_judgements(const data_t *record, const GNPConfig &config) const;
+
+  public:
+    // ノードの種類。
+    std::vector<NodeKind> kinds;
+
+    // ノードの実行に要する時間。
+    std::vector<double> delays;
+
+    // 判定ノードへ入力する要素のインデックス(判定ノード以外では無効)。
+    std::vector<int> sources;
+
+    // 各ノードの接続先が targets のどこから始まるか(ノード数 + 1 個)。
+    std::vector<int> target_offsets;
+
+    // 全ノードの接続先ノードのインデックスを連結したもの。
+    std::vector<int> targets;
+
+    // 各ノードのパラメータが parameters のどこから始まるか(ノード数 + 1 個)。
+    std::vector<int> parameter_offsets;
+
+    // 全ノードのパラメータを連結したもの。
+    // 数値属性の判定ノードではしきい値、カテゴリ属性の判定ノードではカテゴリからブランチのインデックスへの表
+    // (対応するブランチがない場合は -1)、処理ノードでは出力値が格納されます。
+    // カテゴリ数が非常に多い判定ノードでは sparse_tables のインデックスが格納されます。
+    std::vector<data_t> parameters;
+
+    // カテゴリ数が非常に多い判定ノードの変換表。
+    std::vector<CategoryBranchTable> sparse_tables;
+
+    // 制限時間内に到達可能な判定ノードのインデックス(BranchTable 方式でブランチの表を作成するノード)。
+    // ブランチの数が missing_branch 以上の判定ノードがある場合は空になります。
+    std::vector<int> table_nodes;
+
+    // 各ノードのブランチの表が table_nodes の何番目か(表を作成しないノードでは -1)。
+    std::vector<int> table_indices;
+};
+}
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include "Conversion.h"
+#include "runtime_assert.h"
+
+namespace gnp
+{
+Vector<data_t> pyvec2cppvec(const DataAttributeCollection &attributes, boost::python::numpy::ndarray vector_py)
+{
+    Vector<data_t> vector(attributes.size());
+    pyvec2cppvec(attributes, vector_py, vector.data());
+    return vector;
+}
+
+void pyvec2cppvec(const DataAttributeCollection &attributes, boost::python::numpy::ndarray vector_py, data_t *dest)
+{
+    namespace py = boost::python;
+    namespace np = boost::python::numpy;
+
+    auto ndim = vector_py.get_nd();
+    runtime_assert(ndim == 1, "ndim must be 1.");
+
+    auto dims = py::len(vector_py);
+    runtime_assert(attributes.size() == dims, "vector_py dimension do not match the length of attributes.");
+
+    auto copy = [&attributes](const auto *source, data_t *dest) {
+        int dims = attributes.size();
+        for (int index = 0; index < dims; index++)
+        {
+            auto type = attributes[index].type;
+            switch (type)
+            {
+            case DataAttributeType::Category:
+                dest[index].category = (category_t)source[index];
+                break;
+            case DataAttributeType::Numeric:
+                dest[index].numeric = (numeric_t)source[index];
+                break;
+            default:
+                runtime_assert(false);
+                break;
+            }
+        }
+    };
+
+    auto translate = [&attributes](boost::python::numpy::ndarray source, data_t *dest) {
+        int dims = attributes.size();
+        for (int index = 0; index < dims; index++)
+        {
+            auto type = attributes[index].type;
+            switch (type)
+            {
+            case DataAttributeType::Category:
+                dest[index].category = (category_t)py::extract<category_t>(source[index]);
+                break;
+            case DataAttributeType::Numeric:
+                dest[index].numeric = (numeric_t)py::extract<numeric_t>(source[index]);
+                break;
+            default:
+                runtime_assert(false);
+                break;
+            }
+        }
+    };
+
+    auto dtype = vector_py.get_dtype();
+    if (dtype == np::dtype::get_builtin<int8_t>())
+    {
+        auto source = reinterpret_cast<const int8_t *>(vector_py.get_data());
+        copy(source, dest);
+    }
+    else if (dtype == np::dtype::get_builtin<int16_t>())
+    {
+        auto source = reinterpret_cast<const int16_t *>(vector_py.get_data());
+        copy(source, dest);
+    }
+    else if (dtype == np::dtype::get_builtin<int32_t>())
+    {
+        auto source = reinterpret_cast<const int32_t *>(vector_py.get_data());
+        copy(source, dest);
+    }
+    else if (dtype == np::dtype::get_builtin<int64_t>())
+    {
+        auto source = reinterpret_cast<const int64_t *>(vector_py.get_data());
+        copy(source, dest);
+    }
+    else if (dtype == np::dtype::get_builtin<float32_t>())
+    {
+        auto source = reinterpret_cast<const float32_t *>(vector_py.get_data());
+        copy(source, dest);
+    }
+    else if (dtype == np::dtype::get_builtin<float64_t>())
+    {
+        auto source = reinterpret_cast<const float64_t *>(vector_py.get_data());
+        copy(source, dest);
+    }
+    else
+    {
+        // runtime_assert(false, "dtype must be int32, int64, float32, or float64.");
+        translate(vector_py, dest);
+    }
+}
+
+Matrix<data_t> pymat2cppmat(const DataAttributeCollection &attributes, boost::python::numpy::ndarray matrix_py)
+{
+    namespace py = boost::python;
+    namespace np = boost::python::numpy;
+
+    auto ndim = matrix_py.get_nd();
+    runtime_assert(ndim == 2, "ndim must be 2.");
+
+    auto rows = matrix_py.shape(0);
+    auto cols = matrix_py.shape(1);
+    runtime_assert(attributes.size() == cols, "matrix_py columns do not match the length of attributes.");
+
+    // 既知の dtype 以外は float64 に変換してから読み取ります。
+    auto dtype = matrix_py.get_dtype();
+    if (!(dtype == np::dtype::get_builtin<int8_t>() ||
+          dtype == np::dtype::get_builtin<int16_t>() ||
+          dtype == np::dtype::get_builtin<int32_t>() ||
+          dtype == np::dtype::get_builtin<int64_t>() ||
+          dtype == np::dtype::get_builtin<float32_t>() ||
+          dtype == np::dtype::get_builtin<float64_t>()))
+    {
+        matrix_py = matrix_py.astype(np::dtype::get_builtin<float64_t>());
+        dtype = matrix_py.get_dtype();
+    }
+
+    Matrix<data_t> matrix(rows, cols);
+
+    // (ストライドを考慮するため、スライスや転置された配列もそのまま扱えます。)
+    auto copy = [&attributes, &matrix, &matrix_py, rows, cols](auto *type) {
+        using T = std::remove_pointer_t<decltype(type)>;
+        auto base = matrix_py.get_data();
+        auto row_stride = matrix_py.strides(0);
+        auto col_stride = matrix_py.strides(1);
+        for (int i = 0; i < rows; i++)
+        {
+            for (int j = 0; j < cols; j++)
+            {
+                auto source = *reinterpret_cast<const T *>(base + i * row_stride + j * col_stride);
+                switch (attributes[j].type)
+                {
+                case DataAttributeType::Category:
+                    matrix(i, j).category = (category_t)source;
+                    break;
+                case DataAttributeType::Numeric:
+                    matrix(i, j).numeric = (numeric_t)source;
+                    break;
+                default:
+                    runtime_assert(false);
+                    break;
+                }
+            }
+        }
+    };
+
+    if (dtype == np::dtype::get_builtin<int8_t>())
+        copy((int8_t *)nullptr);
+    else if (dtype == np::dtype::get_builtin<int16_t>())
+        copy((int16_t *)nullptr);
+    else if (dtype == np::dtype::get_builtin<int32_t>())
+        copy((int32_t *)nullptr);
+    else if (dtype == np::dtype::get_builtin<int64_t>())
+        copy((int64_t *)nullptr);
+    else if (dtype == np::dtype::get_builtin<float32_t>())
+        copy((float32_t *)nullptr);
+    else
+        copy((float64_t *)nullptr);
+
+    return matrix;
+}
+
+boost::python::numpy::ndarray cppmat2pymat(const DataAttributeCollection &attributes, const Matrix<data_t> &mat)
+{
+    namespace py = boost::python;
+    namespace np = boost::python::numpy;
+
+    auto rows = mat.rows();
+    auto cols = mat.cols();
+    auto shape = py::make_tuple(rows, cols);
+    auto dtype = np::dtype::get_builtin<double>();
+    auto mat_py = np::zeros(shape, dtype);
+    auto mat_py_ = Eigen::Map<Matrix<double>>(reinterpret_cast<double *>(mat_py.get_data()), rows, cols);
+
+    for (int i = 0; i < mat.rows(); i++)
+    {
+        for (int j = 0; j < mat.cols(); j++)
+        {
+            auto type = attributes[j].type;
+            switch (type)
+            {
+            case DataAttributeType::Category:
+                mat_py_(i, j) = (double)mat(i, j).category;
+                break;
+            case DataAttributeType::Numeric:
+                mat_py_(i, j) = (double)mat(i, j).numeric;
+                break;
+            default:
+                runtime_assert(false);
+                break;
+            }
+        }
+    }
+
+    return mat_py;
+}
+
+void cppbuf2pymat(const DataAttributeCollection &attributes, const data_t *buffer, int rows, boost::python::numpy::ndarray mat_py)
+{
+    namespace np = boost::python::numpy;
+
+    auto cols = static_cast<int>(attributes.size());
+    runtime_assert(mat_py.get_nd() == 2, "ndim must be 2.");
+    runtime_assert(mat_py.get_dtype() == np::dtype::get_builtin<double>(), "dtype must be float64.");
+    runtime_assert(rows <= mat_py.shape(0), "The number of rows is not enough.");
+    runtime_assert(cols == mat_py.shape(1), "The number of columns do not match the length of attributes.");
+
+    auto base = mat_py.get_data();
+    auto row_stride = mat_py.strides(0);
+    auto col_stride = mat_py.strides(1);
+    for (int i = 0; i < rows; i++)
+    {
+        for (int j = 0; j < cols; j++)
+        {
+            auto &value = *reinterpret_cast<double *>(base + i * row_stride + j * col_stride);
+            auto &data = buffer[i * cols + j];
+            switch (attributes[j].type)
+            {
+            case DataAttributeType::Category:
+                value = (double)data.category;
+                break;
+            case DataAttributeType::Numeric:
+                value = (double)data.numeric;
+                break;
+            default:
+                runtime_assert(false);
+                break;
+            }
+        }
+    }
+}
+
+boost::python::numpy::ndarray cppbatch2pyarray(const DataAttributeCollection &attributes, const std::vector<Matrix<data_t>> &outputs)
+{
+    namespace py = boost::python;
+    namespace np = boost::python::numpy;
+
+    auto rows = static_cast<int>(outputs.size());
+    auto depth = 0;
+    for (auto &output : outputs)
+        depth = std::max(depth, static_cast<int>(output.rows()));
+    auto cols = static_cast<int>(attributes.size());
+
+    auto shape = py::make_tuple(rows, depth, cols);
+    auto dtype = np::dtype::get_builtin<double>();
+    auto outputs_py = np::empty(shape, dtype);
+    auto data = reinterpret_cast<double *>(outputs_py.get_data());
+    std::fill(data, data + rows * depth * cols, std::numeric_limits<double>::quiet_NaN());
+    for (int i = 0; i < rows; i++)
+    {
+        auto &output = outputs[i];
+        for (int k = 0; k < output.rows(); k++)
+        {
+            for (int j = 0; j < cols; j++)
+            {
+                auto &value = data[(i * depth + k) * cols + j];
+                switch (attributes[j].type)
+                {
+                case DataAttributeType::Category:
+                    value = (double)output(k, j).category;
+                    break;
+                case DataAttributeType::Numeric:
+                    value = (double)output(k, j).numeric;
+                    break;
+                default:
+                    runtime_assert(false);
+                    break;
+                }
+            }
+        }
+    }
+    return outputs_py;
+}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+
+#include "DataAttributeCollection.h"
+#include "GNPTypes.h"
+
+namespace gnp
+{
+// 1 次元の ndarray を属性情報に従って C++ のベクトルに変換します。
+Vector<data_t> pyvec2cppvec(const DataAttributeCollection &attributes, boost::python::numpy::ndarray vector_py);
+
+// 1 次元の ndarray を属性情報に従って変換し、dest に書き込みます(dest には属性数の領域が必要です)。
+void pyvec2cppvec(const DataAttributeCollection &attributes, boost::python::numpy::ndarray vector_py, data_t *dest);
+
+// 2 次元の ndarray を属性情報に従って C++ の行列に変換します(各行が 1 つのレコードに対応します)。
+Matrix<data_t> pymat2cppmat(const DataAttributeCollection &attributes, boost::python::numpy::ndarray matrix_py);
+
+// C++ の行列を属性情報に従って 2 次元の ndarray (float64) に変換します。
+boost::python::numpy::ndarray cppmat2pymat(const DataAttributeCollection &attributes, const Matrix<data_t> &mat);
+
+// rows 行分の出力値を属性情報に従って 2 次元の ndarray (float64) の先頭の行から書き込みます。
+void cppbuf2pymat(const DataAttributeCollection &attributes, const data_t *buffer, int rows, boost::python::numpy::ndarray mat_py);
+
+// レコードごとのノード遷移の結果を (レコード数, 最大出力回数, 出力属性数) の ndarray (float64) に変換します。
+// 出力がない箇所は NaN で埋められます。
+boost::python::numpy::ndarray cppbatch2pyarray(const DataAttributeCollection &attributes, const std::vector<Matrix<data_t>> &outputs);
+}
@@ -0,0 +1,68 @@
+#include <atomic>
+
+#include "Conversion.h"
+#include "Dataset.h"
+#include "format.h"
+#include "runtime_assert.h"
+
+namespace gnp
+{
+// カテゴリ属性の値が属性の範囲に収まっているか検証します。
+// (範囲外の値は判定ノードで分岐先が見つからないため、変換時に検出します。)
+static void validate_categories(const DataAttributeCollection &attributes, const Matrix<data_t> &matrix)
+{
+    for (int j = 0; j < matrix.cols(); j++)
+    {
+        auto &attribute = attributes[j];
+        if (attribute.type != DataAttributeType::Category)
+            continue;
+        for (int i = 0; i < matrix.rows(); i++)
+        {
+            auto value = matrix(i, j).category;
+            runtime_assert(
+                attribute.min.category <= value && value <= attribute.max.category,
+                format("Category({0}) of '{1}' is out of range.", value, attribute.name));
+        }
+    }
+}
+
+std::uint64_t Dataset::issue_id()
+{
+    static std::atomic<std::uint64_t> counter(0);
+    return ++counter;
+}
+
+Dataset::Dataset(Matrix<data_t> inputs, Matrix<data_t> targets)
+    : inputs(std::move(inputs)), targets(std::move(targets))
+{
+    runtime_assert(!this->has_targets() || this->inputs.rows() == this->targets.rows(), "The number of inputs and targets do not match.");
+}
+
+Dataset::Dataset(boost::python::numpy::ndarray inputs_py, const DataAttributeCollection &input_attributes)
+{
+    this->inputs = pymat2cppmat(input_attributes, inputs_py);
+    validate_categories(input_attributes, this->inputs);
+}
+
+Dataset::Dataset(
+    boost::python::numpy::ndarray inputs_py,
+    const DataAttributeCollection &input_attributes,
+    boost::python::numpy::ndarray targets_py,
+    const DataAttributeCollection &output_attributes)
+    : Dataset(inputs_py, input_attributes)
+{
+    namespace py = boost::python;
+
+    if (targets_py.get_nd() == 1)
+        targets_py = targets_py.reshape(py::make_tuple(targets_py.shape(0), 1));
+    this->targets = pymat2cppmat(output_attributes, targets_py);
+    runtime_assert(this->inputs.rows() == this->targets.rows(), "The number of inputs and targets do not match.");
+}
+
+void Dataset::validate(const GNPConfig &config, bool require_targets) const
+{
+    runtime_assert(this->inputs.cols() == config.input_attributes.size(), "inputs columns do not match the length of input attributes.");
+    runtime_assert(!require_targets || this->has_targets(), "Dataset has no targets.");
+    runtime_assert(!this->has_targets() || this->targets.cols() == config.output_attributes.size(), "targets columns do not match the length of output attributes.");
+}
+}
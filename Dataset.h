@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+
+#include "DataAttributeCollection.h"
+#include "GNPConfig.h"
+#include "GNPTypes.h"
+
+namespace gnp
+{
+// C++ 側で保持するデータセットを表します。
+// ndarray の検証と変換を作成時に 1 度だけ行い、以降のノード遷移や評価ではそのまま利用します。
+class Dataset
+{
+  public:
+    Dataset() = default;
+
+    // 変換済みの入力データ(と正解データ)から作成します。
+    Dataset(Matrix<data_t> inputs, Matrix<data_t> targets = Matrix<data_t>());
+
+    // ndarray (int8, int16, int32, int64, float32, float64) の入力データから作成します。
+    Dataset(boost::python::numpy::ndarray inputs, const DataAttributeCollection &input_attributes);
+
+    // ndarray の入力データと正解データから作成します(1 次元の正解データは 1 列とみなします)。
+    Dataset(
+        boost::python::numpy::ndarray inputs,
+        const DataAttributeCollection &input_attributes,
+        boost::python::numpy::ndarray targets,
+        const DataAttributeCollection &output_attributes);
+
+    // レコード数を取得します。
+    int num_records() const
+    {
+        return static_cast<int>(this->inputs.rows());
+    }
+
+    // 正解データを保持しているかどうかを取得します。
+    bool has_targets() const
+    {
+        return 0 < this->targets.cols();
+    }
+
+    // データセットが設定の入出力属性と整合しているか検証します。
+    void validate(const GNPConfig &config, bool require_targets) const;
+
+  public:
+    // 入力データ(レコード数, 入力属性数)。
+    Matrix<data_t> inputs;
+
+    // 正解データ(レコード数, 出力属性数)。正解データがない場合は 0 列です。
+    Matrix<data_t> targets;
+
+    // データセットの識別番号(作成ごとに異なる値で、複製では同じ値になります)。
+    // 評価結果のキャッシュがデータセットの変更を検出するために使用します(inputs を直接書き換えた場合は検出できません)。
+    std::uint64_t id = issue_id();
+
+  private:
+    static std::uint64_t issue_id();
+};
+}
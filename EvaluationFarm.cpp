@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "EvaluationFarm.h"
+#include "ScopedGILRelease.h"
+#include "ThreadPool.h"
+#include "format.h"
+#include "hash.h"
+#include "runtime_assert.h"
+
+namespace gnp
+{
+// size バイトをすべて送信します(受け手が終了している場合は false を返します)。
+static bool write_all(int socket, const void *data, size_t size)
+{
+    auto bytes = static_cast<const char *>(data);
+    while (0 < size)
+    {
+        auto written = ::send(socket, bytes, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+// size バイトをすべて受信します(送り手が終了している場合は false を返します)。
+static bool read_all(int socket, void *data, size_t size)
+{
+    auto bytes = static_cast<char *>(data);
+    while (0 < size)
+    {
+        auto received = ::recv(socket, bytes, size, 0);
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+EvaluationFarm::EvaluationFarm(boost::python::object fitness, boost::python::object dataset, const GNPConfig &config, int num_workers)
+    : fitness(fitness), dataset(dataset), config(config)
+{
+    namespace py = boost::python;
+
+    runtime_assert(0 < num_workers, "Number of workers must be greater than 0.");
+    const Dataset &native_dataset = py::extract<const Dataset &>(dataset);
+    native_dataset.validate(config, false);
+
+    static std::atomic<std::uint64_t> counter(0);
+    this->key = hash_combine(hash_combine(0, native_dataset.id), ++counter);
+
+    // (書き込み途中の出力が子プロセスで重複しないように、fork の前に書き出します。)
+    fflush(nullptr);
+    for (int i = 0; i < num_workers; i++)
+    {
+        int sockets[2];
+        runtime_assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0, "Failed to create a socket pair.");
+#if PY_VERSION_HEX >= 0x03070000
+        PyOS_BeforeFork();
+#endif
+        auto pid = ::fork();
+        if (pid == 0)
+        {
+#if PY_VERSION_HEX >= 0x03070000
+            PyOS_AfterFork_Child();
+#else
+            PyOS_AfterFork();
+#endif
+            ThreadPool::reset_after_fork();
+            ::close(sockets[0]);
+            for (auto &worker : this->workers)
+                ::close(worker.socket);
+            this->workers.clear();
+
+            // (ワーカープロセスは Python に戻らずに終了します。)
+            auto status = 0;
+            try
+            {
+                this->serve(sockets[1]);
+            }
+            catch (...)
+            {
+                status = 1;
+            }
+            fflush(nullptr);
+            ::_exit(status);
+        }
+#if PY_VERSION_HEX >= 0x03070000
+        PyOS_AfterFork_Parent();
+#endif
+        ::close(sockets[1]);
+        if (pid < 0)
+        {
+            ::close(sockets[0]);
+            this->close();
+            runtime_assert(false, "Failed to fork a worker process.");
+        }
+        this->workers.push_back({pid, sockets[0]});
+    }
+}
+
+EvaluationFarm::~EvaluationFarm()
+{
+    this->close();
+}
+
+void EvaluationFarm::serve(int socket)
+{
+    namespace py = boost::python;
+
+    auto message = std::vector<char>();
+    for (;;)
+    {
+        std::uint32_t size;
+        if (!read_all(socket, &size, sizeof(size)))
+            break;
+        message.resize(size);
+        if (!read_all(socket, message.data(), size))
+            break;
+
+        Genome genome;
+        BinaryReader reader(message.data(), message.data() + size);
+        genome.decode(reader, this->config);
+
+        // 応答は 適合度、エラーの有無 の順です(エラーの内容はワーカープロセスの標準エラー出力に表示します)。
+        auto fitness = std::numeric_limits<double>::quiet_NaN();
+        std::uint8_t failed = 0;
+        try
+        {
+            fitness = py::extract<double>(this->fitness(genome, this->dataset));
+        }
+        catch (const py::error_already_set &)
+        {
+            PyErr_Print();
+            failed = 1;
+        }
+        if (!write_all(socket, &fitness, sizeof(fitness)) || !write_all(socket, &failed, sizeof(failed)))
+            break;
+    }
+    ::close(socket);
+}
+
+void EvaluationFarm::send(const Worker &worker, const Genome &genome)
+{
+    // 個体はバイト数、Genome::encode の内容 の順に送ります。
+    this->buffer.clear();
+    BinaryWriter writer(this->buffer);
+    writer.write<std::uint32_t>(0);
+    genome.encode(writer, this->config);
+    auto size = static_cast<std::uint32_t>(this->buffer.size() - sizeof(std::uint32_t));
+    std::memcpy(this->buffer.data(), &size, sizeof(size));
+    if (!write_all(worker.socket, this->buffer.data(), this->buffer.size()))
+        throw std::runtime_error(format("Worker process ({0}) exited unexpectedly.", worker.pid));
+    this->genomes_sent++;
+    this->bytes_sent += this->buffer.size();
+}
+
+double EvaluationFarm::receive(const Worker &worker)
+{
+    double fitness;
+    std::uint8_t failed;
+    if (!read_all(worker.socket, &fitness, sizeof(fitness)) || !read_all(worker.socket, &failed, sizeof(failed)))
+        throw std::runtime_error(format("Worker process ({0}) exited unexpectedly.", worker.pid));
+    if (failed)
+        throw std::runtime_error(format("Fitness function raised an exception in worker process ({0}).", worker.pid));
+    return fitness;
+}
+
+std::vector<double> EvaluationFarm::evaluate(Population &population)
+{
+    runtime_assert(!this->workers.empty(), "Evaluation farm is closed.");
+    auto &genomes = population.genomes;
+    auto num_genomes = static_cast<int>(genomes.size());
+
+    // 内容が同じ個体は、最初の個体だけを評価します。
+    auto pending = std::vector<int>();
+    auto duplicates = std::vector<int>();
+    auto first_indices = std::unordered_map<std::uint64_t, int>();
+    for (int i = 0; i < num_genomes; i++)
+    {
+        auto &genome = genomes[i];
+        if (genome.inherits_fitness && genome.evaluation_key == this->key)
+            continue;
+        if (first_indices.emplace(genome.hash, i).second)
+            pending.push_back(i);
+        else
+            duplicates.push_back(i);
+    }
+
+    // 各ワーカープロセスに 1 個ずつ送り、適合度を受け取ったワーカープロセスに次の個体を送ります。
+    // (例外が発生した場合も、送信済みの個体の応答はすべて受け取ってから送出します。)
+    auto num_workers = static_cast<int>(this->workers.size());
+    auto num_pending = static_cast<int>(pending.size());
+    auto assigned = std::vector<int>(num_workers, -1);
+    auto next = 0;
+    auto error = std::exception_ptr();
+    for (int w = 0; w < num_workers && next < num_pending && !error; w++)
+    {
+        try
+        {
+            this->send(this->workers[w], genomes[pending[next]]);
+            assigned[w] = next++;
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+    }
+
+    auto fds = std::vector<pollfd>();
+    auto fd_workers = std::vector<int>();
+    for (;;)
+    {
+        fds.clear();
+        fd_workers.clear();
+        for (int w = 0; w < num_workers; w++)
+        {
+            if (assigned[w] < 0)
+                continue;
+            fds.push_back({this->workers[w].socket, POLLIN, 0});
+            fd_workers.push_back(w);
+        }
+        if (fds.empty())
+            break;
+        if (::poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("Failed to wait for worker processes.");
+        }
+
+        for (int k = 0; k < fds.size(); k++)
+        {
+            if (fds[k].revents == 0)
+                continue;
+            auto w = fd_workers[k];
+            auto &genome = genomes[pending[assigned[w]]];
+            assigned[w] = -1;
+            try
+            {
+                genome.fitness = this->receive(this->workers[w]);
+                genome.metric_value = genome.fitness;
+                genome.evaluation_key = this->key;
+            }
+            catch (...)
+            {
+                if (!error)
+                    error = std::current_exception();
+            }
+            if (!error && next < num_pending)
+            {
+                try
+                {
+                    this->send(this->workers[w], genomes[pending[next]]);
+                    assigned[w] = next++;
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+            }
+        }
+    }
+    if (error)
+        std::rethrow_exception(error);
+
+    for (auto i : duplicates)
+    {
+        auto &genome = genomes[i];
+        auto &source = genomes[first_indices[genome.hash]];
+        genome.fitness = source.fitness;
+        genome.metric_value = source.metric_value;
+        genome.evaluation_key = source.evaluation_key;
+    }
+
+    auto values = std::vector<double>(num_genomes);
+    for (int i = 0; i < num_genomes; i++)
+        values[i] = genomes[i].fitness;
+    return values;
+}
+
+boost::python::numpy::ndarray EvaluationFarm::evaluate_py(Population &population)
+{
+    namespace py = boost::python;
+    namespace np = boost::python::numpy;
+
+    std::vector<double> values;
+    {
+        ScopedGILRelease release;
+        values = this->evaluate(population);
+    }
+
+    auto values_py = np::empty(py::make_tuple(values.size()), np::dtype::get_builtin<double>());
+    std::copy(values.begin(), values.end(), reinterpret_cast<double *>(values_py.get_data()));
+    return values_py;
+}
+
+void EvaluationFarm::close()
+{
+    // (ソケットを閉じると、ワーカープロセスは受信に失敗して終了します。)
+    for (auto &worker : this->workers)
+        ::close(worker.socket);
+    for (auto &worker : this->workers)
+    {
+        while (::waitpid(worker.pid, nullptr, 0) < 0 && errno == EINTR)
+            ;
+    }
+    this->workers.clear();
+}
+
+int EvaluationFarm::get_num_workers() const
+{
+    return static_cast<int>(this->workers.size());
+}
+}
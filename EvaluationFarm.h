@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <sys/types.h>
+
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+
+#include "GNPConfig.h"
+#include "Genome.h"
+#include "Population.h"
+
+namespace gnp
+{
+// 適合度を Python の関数で計算する評価を、fork した複数のワーカープロセスで並列に行います。
+// 個体は Genome::encode の形式で Unix ドメインソケット(socketpair)を介して送り、適合度を受け取ります。
+// データセットは fork の前に作成されたものを各ワーカープロセスがそのまま参照します。
+// (データセットの行列には書き込まないため、メモリのページは複製されずにプロセス間で共有されたままです。)
+class EvaluationFarm
+{
+  public:
+    // fitness(genome, dataset) を呼び出して適合度を求めるワーカープロセスを num_workers 個起動します。
+    // dataset は gnp.Dataset で、GIL を保持したスレッドから呼び出す必要があります。
+    EvaluationFarm(boost::python::object fitness, boost::python::object dataset, const GNPConfig &config, int num_workers);
+
+    ~EvaluationFarm();
+
+    EvaluationFarm(const EvaluationFarm &) = delete;
+
+    EvaluationFarm &operator=(const EvaluationFarm &) = delete;
+
+    // 個体群の各個体の適合度をワーカープロセスで計算し、各個体の fitness に設定します。戻り値は各個体の適合度です。
+    // 内容が同じ個体は 1 度だけ評価し、このファームで評価された親個体の適合度を引き継げる個体は評価を省略します。
+    // ワーカープロセスで例外が発生した場合は std::runtime_error を送出します。
+    std::vector<double> evaluate(Population &population);
+
+    // 個体群を評価します(評価の間は GIL を解放します)。
+    boost::python::numpy::ndarray evaluate_py(Population &population);
+
+    // ワーカープロセスを終了させ、終了を待ちます。
+    void close();
+
+    // ワーカープロセスの数を取得します。
+    int get_num_workers() const;
+
+  public:
+    // 評価した個体の数と、送信したバイト数。
+    long long genomes_sent = 0;
+    long long bytes_sent = 0;
+
+  private:
+    struct Worker
+    {
+        pid_t pid;
+
+        // ワーカープロセスと接続したソケット。
+        int socket;
+    };
+
+    // ワーカープロセスに個体を送ります。
+    void send(const Worker &worker, const Genome &genome);
+
+    // ワーカープロセスから適合度を受け取ります。
+    double receive(const Worker &worker);
+
+    // ワーカープロセスで、ソケットから受け取った個体を評価し続けます(ソケットが閉じられると終了します)。
+    void serve(int socket);
+
+    boost::python::object fitness;
+    boost::python::object dataset;
+    GNPConfig config;
+
+    std::vector<Worker> workers;
+
+    // このファームによる評価を表すキー(Genome::evaluation_key に設定します)。
+    std::uint64_t key;
+
+    // 送信する個体の作業領域。
+    std::vector<char> buffer;
+};
+}
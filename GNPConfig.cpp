@@ -1,3 +1,4 @@
+#include <cmath>
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -110,6 +111,12 @@ GNPConfig::GNPConfig(const char *path)
     this->data_source_mutation_rate = extract_numeric<double>(root, "data_source_mutation_rate");
     this->judgement_function_mutation_rate = extract_numeric<double>(root, "judgement_function_mutation_rate");
     this->output_mutation_rate = extract_numeric<double>(root, "output_mutation_rate");
+    this->selection = exists(root, "selection") ? to_selection_type(root.at("selection").get<std::string>()) : SelectionType::Roulette;
+    this->tournament_size = exists(root, "tournament_size") ? extract_numeric<int>(root, "tournament_size") : 2;
+    this->rank_selection_pressure = exists(root, "rank_selection_pressure") ? extract_numeric<double>(root, "rank_selection_pressure") : 1.5;
+    this->truncation_rate = exists(root, "truncation_rate") ? extract_numeric<double>(root, "truncation_rate") : 0.5;
+    this->seed = exists(root, "seed") ? extract_numeric<long long>(root, "seed") : -1;
+    this->num_threads = exists(root, "num_threads") ? extract_numeric<int>(root, "num_threads") : 0;
     this->time_limit = extract_numeric<double>(root, "time_limit");
     this->delay_time_processing_node = extract_numeric<double>(root, "delay_time_processing_node");
     this->delay_time_judgement_node = extract_numeric<double>(root, "delay_time_judgement_node");
@@ -140,11 +147,83 @@ GNPConfig::GNPConfig(const char *path)
     runtime_assert(range_validation<double>(this->data_source_mutation_rate, 0, 1));
     runtime_assert(range_validation<double>(this->judgement_function_mutation_rate, 0, 1));
     runtime_assert(range_validation<double>(this->output_mutation_rate, 0, 1));
+    runtime_assert(range_validation<int>(this->tournament_size, 1, no_limitation));
+    runtime_assert(range_validation<double>(this->rank_selection_pressure, 1, 2));
+    runtime_assert(0 < this->truncation_rate && this->truncation_rate <= 1);
+    runtime_assert(range_validation<int>(this->num_threads, 0, no_limitation));
     runtime_assert(range_validation<double>(this->time_limit, 0, no_limitation));
     runtime_assert(range_validation<double>(this->delay_time_processing_node, 0, no_limitation));
     runtime_assert(range_validation<double>(this->delay_time_judgement_node, 0, no_limitation));
 }
 
+std::string GNPConfig::get_selection() const
+{
+    return gnp::to_string(this->selection);
+}
+
+void GNPConfig::set_selection(const std::string &name)
+{
+    this->selection = to_selection_type(name);
+}
+
+int GNPConfig::get_tournament_size() const
+{
+    return this->tournament_size;
+}
+
+void GNPConfig::set_tournament_size(int value)
+{
+    runtime_assert(range_validation<int>(value, 1, no_limitation), "Tournament size must be greater than 0.");
+    this->tournament_size = value;
+}
+
+double GNPConfig::get_rank_selection_pressure() const
+{
+    return this->rank_selection_pressure;
+}
+
+void GNPConfig::set_rank_selection_pressure(double value)
+{
+    runtime_assert(range_validation<double>(value, 1, 2), "Rank selection pressure must be in [1, 2].");
+    this->rank_selection_pressure = value;
+}
+
+double GNPConfig::get_truncation_rate() const
+{
+    return this->truncation_rate;
+}
+
+void GNPConfig::set_truncation_rate(double value)
+{
+    runtime_assert(0 < value && value <= 1, "Truncation rate must be in (0, 1].");
+    this->truncation_rate = value;
+}
+
+int GNPConfig::num_genes() const
+{
+    return 1 + this->num_category_judgement_nodes + this->num_numeric_judgement_nodes + this->num_processing_nodes;
+}
+
+int GNPConfig::max_num_outputs() const
+{
+    if (this->time_limit <= 0)
+        return 0;
+
+    // 処理ノードの実行ごとに時間を消費する場合は、時間の上限値から決まります。
+    // (残り時間から実行時間を繰り返し減算する際の丸め誤差で 1 回多く実行される場合があるため、1 を加えます。)
+    if (0 < this->delay_time_processing_node)
+        return static_cast<int>(std::ceil(this->time_limit / this->delay_time_processing_node)) + 1;
+
+    // そうでない場合、判定ノードを経由せずに処理ノードを連続して実行できるのは処理ノードの数までです。
+    // (それ以上は処理ノードだけの閉路となり、ノード遷移が終了しません。)
+    if (0 < this->delay_time_judgement_node)
+    {
+        auto num_judgements = static_cast<int>(std::ceil(this->time_limit / this->delay_time_judgement_node)) + 1;
+        return (num_judgements + 1) * this->num_processing_nodes;
+    }
+    return this->num_processing_nodes;
+}
+
 std::string GNPConfig::to_string() const
 {
     std::stringstream stream;
@@ -163,6 +242,12 @@ std::string GNPConfig::to_string() const
     stream << "data_source_mutation_rate: " << this->data_source_mutation_rate << std::endl;
     stream << "judgement_function_mutation_rate: " << this->judgement_function_mutation_rate << std::endl;
     stream << "output_mutation_rate: " << this->output_mutation_rate << std::endl;
+    stream << "selection: " << gnp::to_string(this->selection) << std::endl;
+    stream << "tournament_size: " << this->tournament_size << std::endl;
+    stream << "rank_selection_pressure: " << this->rank_selection_pressure << std::endl;
+    stream << "truncation_rate: " << this->truncation_rate << std::endl;
+    stream << "seed: " << this->seed << std::endl;
+    stream << "num_threads: " << this->num_threads << std::endl;
     stream << "time_limit: " << this->time_limit << std::endl;
     stream << "delay_time_processing_node: " << this->delay_time_processing_node << std::endl;
     stream << "delay_time_judgement_node: " << this->delay_time_judgement_node << std::endl;
@@ -7,6 +7,7 @@
 #include "DataAttribute.h"
 #include "DataAttributeCollection.h"
 #include "GNPTypes.h"
+#include "Selection.h"
 
 namespace gnp
 {
@@ -18,6 +19,12 @@ class GNPConfig
 
     std::string to_string() const;
 
+    // 1 回のノード遷移で処理ノードが出力する回数の上限値です(出力用のバッファの大きさの決定に使用します)。
+    int max_num_outputs() const;
+
+    // 1 個体あたりのノードの総数です(遷移開始ノードを含みます)。
+    int num_genes() const;
+
   public:
     /**
      * ネットワークの入力に関する設定です。
@@ -65,6 +72,45 @@ class GNPConfig
     // 処理ノードにおける出力値の突然変異率です。
     double output_mutation_rate;
 
+    // 親個体の選択方式です(省略時は "roulette")。
+    SelectionType selection;
+
+    // トーナメント選択で比較する個体の数です(省略時は 2)。
+    int tournament_size;
+
+    // ランキング選択における最上位の個体の重みです。1 から 2 の範囲で、1 は一様な選択になります(省略時は 1.5)。
+    double rank_selection_pressure;
+
+    // トランケーション選択で親個体の候補とする上位の個体の割合です(省略時は 0.5)。
+    double truncation_rate;
+
+    // Population の乱数のシードです。負の場合はランダムなシードを使用します(省略時は -1)。
+    // シードが同じであれば、スレッドの数によらず同じ個体群が生成されます。
+    long long seed;
+
+    // 並列処理に使用するスレッド数です(省略時は 0 で、共有のスレッドプールを使用します)。
+    // 正の場合は、この設定で行う並列処理をそのスレッド数のスレッドプールで実行します(共有のスレッドプールのスレッド数は変更しません)。
+    int num_threads;
+
+    // 親個体の選択方式を文字列で取得します。
+    std::string get_selection() const;
+
+    // 親個体の選択方式を文字列("roulette", "tournament", "rank", "truncation")で設定します。
+    void set_selection(const std::string &name);
+
+    // 選択方式のパラメータを取得、設定します(設定では、設定ファイルの読み込みと同じ範囲の検証を行います)。
+    int get_tournament_size() const;
+
+    void set_tournament_size(int value);
+
+    double get_rank_selection_pressure() const;
+
+    void set_rank_selection_pressure(double value);
+
+    double get_truncation_rate() const;
+
+    void set_truncation_rate(double value);
+
     /**
      *  Genetic Network Programming 固有の設定です。
      **/
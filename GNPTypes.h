@@ -5,6 +5,8 @@
 
 #include <Eigen/Core>
 
+#include "Philox.h"
+
 namespace gnp
 {
 typedef float float32_t;
@@ -25,29 +27,19 @@ union data_t {
     category_t category;
 };
 
+// (ビット列として比較します。category_t は numeric_t と同じ大きさです。)
 inline bool operator==(data_t a, data_t b)
 {
-#ifdef GNP_USE_DOUBLE_PRECISION
-    return reinterpret_cast<int64_t&>(a) == reinterpret_cast<int64_t&>(b);
-#else
-    return reinterpret_cast<int32_t&>(a) == reinterpret_cast<int32_t&>(b);
-#endif    
+    return a.category == b.category;
 }
 
 inline bool operator!=(data_t a, data_t b)
 {
-#ifdef GNP_USE_DOUBLE_PRECISION
-    return reinterpret_cast<int64_t&>(a) != reinterpret_cast<int64_t&>(b);
-#else
-    return reinterpret_cast<int32_t&>(a) != reinterpret_cast<int32_t&>(b);
-#endif    
+    return a.category != b.category;
 }
 
-#if defined(__x86_64__) || defined(_WIN64)
-typedef std::mt19937_64 randomizer_t;
-#else
-typedef std::mt19937 randomizer_t;
-#endif
+// 乱数生成器(系列ごとに独立して作成できる、カウンタベースの生成器です)。
+typedef Philox randomizer_t;
 
 template <typename T>
 using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
@@ -0,0 +1,40 @@
+#include <atomic>
+
+#include "GenePool.h"
+#include "Genome.h"
+
+namespace gnp
+{
+void GenePool::recycle(Genome &genome)
+{
+    for (auto &gene : genome.genes)
+        this->recycle(std::move(gene));
+    genome.genes.clear();
+}
+
+void GenePool::recycle(std::shared_ptr<const AbstractNodeGene> &&gene)
+{
+    if (gene && gene.use_count() == 1)
+    {
+        // (他に参照がないので、内容を書き換えても他の個体には影響しません。
+        //  他のスレッドが直前に手放した参照による読み取りとの順序を保証します。)
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto &genes = this->free_genes[std::type_index(typeid(*gene))];
+        genes.push_back(std::const_pointer_cast<AbstractNodeGene>(std::move(gene)));
+    }
+    gene.reset();
+}
+
+void GenePool::clear()
+{
+    this->free_genes.clear();
+}
+
+int GenePool::size() const
+{
+    auto size = 0;
+    for (auto &pair : this->free_genes)
+        size += static_cast<int>(pair.second.size());
+    return size;
+}
+}
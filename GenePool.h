@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "GNPConfig.h"
+#include "NodeGene.h"
+
+namespace gnp
+{
+class Genome;
+
+// 破棄された個体のノードを種類ごとに保持し、ノードの複製で再利用するプールです。
+// 再利用するノードには複製元の内容を代入するため、ノードが持つ配列などの領域も再利用されます。
+// (ノードは個体間で共有されるため、他の個体から参照されていないノードだけをプールに戻します。)
+// スレッドごとに用意して使用します(スレッドセーフではありません)。
+class GenePool
+{
+  public:
+    GenePool() = default;
+
+    // (複製するとノードと統計情報の扱いが曖昧になるため、移動だけを許可します。)
+    GenePool(const GenePool &) = delete;
+
+    GenePool &operator=(const GenePool &) = delete;
+
+    GenePool(GenePool &&) = default;
+
+    GenePool &operator=(GenePool &&) = default;
+
+    // source の複製を作成します(プールに同じ種類のノードがある場合は再利用します)。
+    template <typename T>
+    std::shared_ptr<AbstractNodeGene> duplicate(const T &source);
+
+    // 新しいノードを作成します。
+    template <typename T>
+    std::shared_ptr<AbstractNodeGene> create(int index, const GNPConfig &config);
+
+    // 個体のノードへの参照をすべて手放し、他に参照されていないノードをプールに戻します(個体のノードは空になります)。
+    void recycle(Genome &genome);
+
+    // ノードへの参照を手放し、他に参照されていなければプールに戻します。
+    void recycle(std::shared_ptr<const AbstractNodeGene> &&gene);
+
+    // プールに保持しているノードを破棄します(統計情報は保持されます)。
+    void clear();
+
+    // プールに保持しているノードの数を取得します。
+    int size() const;
+
+  public:
+    // ヒープ領域に確保したノードの数。
+    long long allocations = 0;
+
+    // プールから再利用したノードの数。
+    long long reuses = 0;
+
+  private:
+    std::unordered_map<std::type_index, std::vector<std::shared_ptr<AbstractNodeGene>>> free_genes;
+};
+
+template <typename T>
+std::shared_ptr<AbstractNodeGene> GenePool::duplicate(const T &source)
+{
+    auto &genes = this->free_genes[std::type_index(typeid(T))];
+    if (genes.empty())
+    {
+        this->allocations++;
+        return std::make_shared<T>(source);
+    }
+    auto gene = std::move(genes.back());
+    genes.pop_back();
+    static_cast<T &>(*gene) = source;
+    this->reuses++;
+    return gene;
+}
+
+template <typename T>
+std::shared_ptr<AbstractNodeGene> GenePool::create(int index, const GNPConfig &config)
+{
+    this->allocations++;
+    return std::make_shared<T>(index, config);
+}
+}
@@ -1,12 +1,20 @@
 #include <algorithm>
 #include <fstream>
+#include <functional>
 #include <iomanip>
-#include <list>
+#include <queue>
+#include <utility>
+#include <vector>
 #include <sstream>
 
 #include <picojson.h>
 
+#include "CompiledGenome.h"
+#include "Conversion.h"
+#include "GenePool.h"
 #include "Genome.h"
+#include "MutationSampler.h"
+#include "ScopedGILRelease.h"
 #include "assert.h"
 #include "format.h"
 #include "runtime_assert.h"
@@ -18,61 +26,264 @@ static inline double dice(randomizer_t &randomizer)
     return std::uniform_real_distribution<double>(0.0, 1.0)(randomizer);
 }
 
-void Genome::configure_new(randomizer_t &randomizer, const GNPConfig &config)
+void Genome::configure_new(randomizer_t &randomizer, const GNPConfig &config, GenePool *pool)
 {
-    this->allocate_memory(config);
-
     this->fitness = 0.0;
-    std::for_each(this->genes.begin(), this->genes.end(), [&randomizer, &config](auto &gene) {
-        constexpr bool force_mutation = true;
-        gene->mutate(randomizer, config, force_mutation);
-    });
+    this->metric_value = 0.0;
+    this->evaluation_key = 0;
+    this->inherits_fitness = false;
+    this->inheritance_reason = InheritanceReason::None;
+    this->dirty_genes.clear();
+    this->parent_hash = 0;
+    auto genes = this->allocate_memory(config, pool);
+    for (auto &gene : genes)
+        gene->randomize(randomizer, config);
+    this->genes.assign(genes.begin(), genes.end());
+    this->update_hash();
 }
 
-void Genome::configure_inheritance(const Genome &parent)
+void Genome::configure_inheritance(const Genome &parent, GenePool *pool)
 {
     this->fitness = parent.fitness;
-
-    auto num_genes = parent.genes.size();
-    this->genes.clear();
-    this->genes.reserve(num_genes);
-    for (int i = 0; i < num_genes; i++)
-    {
-        this->genes.push_back(parent.genes[i]->duplicate(this));
-    }
+    this->hash = parent.hash;
+    this->metric_value = parent.metric_value;
+    this->evaluation_key = parent.evaluation_key;
+    this->inherits_fitness = true;
+    this->inheritance_reason = InheritanceReason::Unchanged;
+    this->parent_hash = parent.hash;
+
+    // ノードは変更されないので、親個体と共有します。
+    this->dirty_genes.assign(parent.genes.size(), false);
+    if (pool)
+        pool->recycle(*this);
+    this->genes = parent.genes;
 }
 
 void Genome::configure_inheritance_move(Genome &&parent)
 {
     this->fitness = std::move(parent.fitness);
+    this->hash = parent.hash;
+    this->metric_value = parent.metric_value;
+    this->evaluation_key = parent.evaluation_key;
+    this->inherits_fitness = parent.inherits_fitness;
+    this->inheritance_reason = parent.inheritance_reason;
+    this->dirty_genes = std::move(parent.dirty_genes);
+    this->parent_hash = parent.parent_hash;
     this->genes = std::move(parent.genes);
-    for (auto &gene : this->genes)
-        gene->owner = this;
-    for (auto &gene : parent.genes)
-        gene->owner = nullptr;
 }
 
-void Genome::configure_crossover(randomizer_t &randomizer, const Genome &parent1, const Genome &parent2)
+void Genome::configure_copy(const Genome &source)
+{
+    // (複製は子個体ではないため、親個体との関係も複製元のものを引き継ぎます。)
+    this->fitness = source.fitness;
+    this->hash = source.hash;
+    this->metric_value = source.metric_value;
+    this->evaluation_key = source.evaluation_key;
+    this->inherits_fitness = source.inherits_fitness;
+    this->inheritance_reason = source.inheritance_reason;
+    this->dirty_genes = source.dirty_genes;
+    this->parent_hash = source.parent_hash;
+    this->genes = source.genes;
+}
+
+void Genome::configure_crossover(randomizer_t &randomizer, const Genome &parent1, const Genome &parent2, GenePool *pool)
 {
     auto num_genes = parent1.genes.size();
     assert(num_genes == parent1.genes.size());
     assert(num_genes == parent2.genes.size());
 
+    if (pool)
+        pool->recycle(*this);
     this->genes.clear();
     this->genes.reserve(num_genes);
+    this->hash = 0;
     for (int i = 0; i < num_genes; i++)
     {
         if (dice(randomizer) < 0.5)
-            this->genes.push_back(parent1.genes[i]->duplicate(this));
+            this->genes.push_back(parent1.genes[i]);
         else
-            this->genes.push_back(parent2.genes[i]->duplicate(this));
+            this->genes.push_back(parent2.genes[i]);
+        this->hash ^= this->genes.back()->hash;
+    }
+    this->evaluation_key = 0;
+    this->inherits_fitness = false;
+    this->inheritance_reason = InheritanceReason::None;
+    this->dirty_genes.clear();
+    this->parent_hash = 0;
+}
+
+void Genome::configure_crossover(randomizer_t &randomizer, const Genome &parent1, const Genome &parent2, const GNPConfig &config, GenePool *pool)
+{
+    this->configure_crossover(randomizer, parent1, parent2, pool);
+
+    // 到達可能なノードがすべて一方の親個体と同じであれば、その親個体の適合度を引き継ぎます。
+    // 引き継げない場合は、変更されたノードが少ない方の親個体を基準に変更を追跡します。
+    auto num_genes = this->genes.size();
+    const Genome *basis = nullptr;
+    auto min_dirty_genes = num_genes + 1;
+    for (auto parent : {&parent1, &parent2})
+    {
+        this->dirty_genes.resize(num_genes);
+        for (int i = 0; i < num_genes; i++)
+            this->dirty_genes[i] = this->genes[i]->hash != parent->genes[i]->hash;
+        this->fitness = parent->fitness;
+        this->metric_value = parent->metric_value;
+        this->evaluation_key = parent->evaluation_key;
+        this->parent_hash = parent->hash;
+        this->update_inheritance(config);
+        if (this->inherits_fitness)
+            return;
+
+        auto num_dirty_genes = static_cast<size_t>(std::count(this->dirty_genes.begin(), this->dirty_genes.end(), true));
+        if (num_dirty_genes < min_dirty_genes)
+        {
+            basis = parent;
+            min_dirty_genes = num_dirty_genes;
+        }
+    }
+    if (basis != &parent2)
+    {
+        for (int i = 0; i < num_genes; i++)
+            this->dirty_genes[i] = this->genes[i]->hash != basis->genes[i]->hash;
+        this->fitness = basis->fitness;
+        this->metric_value = basis->metric_value;
+        this->evaluation_key = basis->evaluation_key;
+        this->parent_hash = basis->hash;
     }
 }
 
-void Genome::mutate(randomizer_t &randomizer, const GNPConfig &config)
+bool Genome::mutate(randomizer_t &randomizer, const GNPConfig &config, GenePool *pool)
 {
+    runtime_assert(this->genes.size() == config.num_genes());
+
+    // 変更する箇所を先に抽出し、該当するノードだけを複製して差し替え、ハッシュ値もその分だけ差し替えます。
+    thread_local std::vector<MutationSite> sites;
+    MutationSampler(config).sample(randomizer, sites);
+    bool changed = false;
+    for (auto first = sites.begin(); first != sites.end();)
+    {
+        auto index = first->gene;
+        auto last = std::find_if(first, sites.end(), [index](const MutationSite &site) { return site.gene != index; });
+        auto &gene = this->genes[index];
+        auto mutated = gene->mutate(randomizer, config, MutationSites(&*first, &*first + (last - first)), pool);
+        first = last;
+        if (!mutated)
+            continue;
+        this->hash ^= gene->hash ^ mutated->hash;
+        changed = true;
+        if (!this->dirty_genes.empty())
+            this->dirty_genes[gene->index] = true;
+        if (pool)
+            pool->recycle(std::move(gene));
+        gene = std::move(mutated);
+    }
+    if (changed)
+        this->update_inheritance(config);
+    return changed;
+}
+
+void Genome::update_inheritance(const GNPConfig &config)
+{
+    this->inherits_fitness = false;
+    this->inheritance_reason = InheritanceReason::None;
+    if (this->dirty_genes.empty())
+        return;
+
+    if (std::none_of(this->dirty_genes.begin(), this->dirty_genes.end(), [](bool dirty) { return dirty; }))
+    {
+        this->inherits_fitness = true;
+        this->inheritance_reason = InheritanceReason::Unchanged;
+        return;
+    }
+
+    thread_local std::vector<bool> reachable;
+    this->find_reachable_genes(config, reachable);
+    for (int i = 0; i < this->dirty_genes.size(); i++)
+    {
+        if (this->dirty_genes[i] && reachable[i])
+            return;
+    }
+    this->inherits_fitness = true;
+    this->inheritance_reason = InheritanceReason::UnreachableChanges;
+}
+
+std::vector<bool> Genome::reachable_genes(const GNPConfig &config) const
+{
+    auto reachable = std::vector<bool>();
+    this->find_reachable_genes(config, reachable);
+    return reachable;
+}
+
+void Genome::find_reachable_genes(const GNPConfig &config, std::vector<bool> &reachable) const
+{
+    // 遷移開始ノードから各ノードに到達するまでの最短時間を求めます。
+    // (経過時間の計算順序による誤差で到達可能なノードを除外しないように、制限時間に僅かな余裕を持たせます。)
+    // 作業領域はスレッドごとに再利用します。
+    typedef std::pair<double, int> entry_t;
+    thread_local std::vector<double> times;
+    thread_local std::vector<entry_t> queue;
+    auto num_genes = static_cast<int>(this->genes.size());
+    auto time_limit = config.time_limit * (1 + 1e-9) + 1e-12;
+    times.assign(num_genes, time_limit);
+    queue.clear();
+    auto push = [](double time, int index) {
+        queue.emplace_back(time, index);
+        std::push_heap(queue.begin(), queue.end(), std::greater<entry_t>());
+    };
+    if (0 < num_genes)
+    {
+        times[0] = 0;
+        push(0, 0);
+    }
+    while (!queue.empty())
+    {
+        std::pop_heap(queue.begin(), queue.end(), std::greater<entry_t>());
+        auto time = queue.back().first;
+        auto index = queue.back().second;
+        queue.pop_back();
+        if (times[index] < time)
+            continue;
+
+        auto gene = this->genes[index].get();
+        auto visit = [&](int target) {
+            auto next_time = time + gene->delay;
+            if (next_time < times[target])
+            {
+                times[target] = next_time;
+                push(next_time, target);
+            }
+        };
+        if (auto node = dynamic_cast<const InitialNodeGene *>(gene))
+            visit(node->target);
+        else if (auto node = dynamic_cast<const ProcessingNodeGene *>(gene))
+            visit(node->target);
+        else if (auto node = dynamic_cast<const AbstractJudgementNodeGene *>(gene))
+            std::for_each(node->targets.begin(), node->targets.end(), visit);
+    }
+
+    reachable.resize(num_genes);
+    for (int i = 0; i < num_genes; i++)
+        reachable[i] = times[i] < time_limit;
+}
+
+std::string Genome::get_inheritance_reason() const
+{
+    switch (this->inheritance_reason)
+    {
+    case InheritanceReason::Unchanged:
+        return "unchanged";
+    case InheritanceReason::UnreachableChanges:
+        return "unreachable_changes";
+    default:
+        return "none";
+    }
+}
+
+void Genome::update_hash()
+{
+    this->hash = 0;
     for (auto &gene : this->genes)
-        gene->mutate(randomizer, config);
+        this->hash ^= gene->hash;
 }
 
 void Genome::serialize(const char *path, const GNPConfig &config) const
@@ -106,14 +317,51 @@ void Genome::deserialize(const char *path, const GNPConfig &config)
 
 void Genome::deserialize_from_object(const picojson::object &object, const GNPConfig &config)
 {
-    this->allocate_memory(config);
+    auto genes = this->allocate_memory(config, nullptr);
     this->fitness = object.at("fitness").get<double>();
-    auto &genes = object.at("genes").get<picojson::array>();
-    runtime_assert(this->genes.size() == genes.size());
-    for (int i = 0; i < genes.size(); i++)
+    this->metric_value = 0.0;
+    this->evaluation_key = 0;
+    this->inherits_fitness = false;
+    this->inheritance_reason = InheritanceReason::None;
+    this->dirty_genes.clear();
+    this->parent_hash = 0;
+    auto &objects = object.at("genes").get<picojson::array>();
+    runtime_assert(genes.size() == objects.size());
+    for (int i = 0; i < objects.size(); i++)
+    {
+        genes[i]->deserialize(objects[i].get<picojson::object>(), config);
+        genes[i]->update_hash();
+    }
+    this->genes.assign(genes.begin(), genes.end());
+    this->update_hash();
+}
+
+void Genome::encode(BinaryWriter &writer, const GNPConfig &config) const
+{
+    writer.write(this->fitness);
+    writer.write<std::int32_t>(this->genes.size());
+    for (auto &gene : this->genes)
+        gene->encode(writer, config);
+}
+
+void Genome::decode(BinaryReader &reader, const GNPConfig &config)
+{
+    auto genes = this->allocate_memory(config, nullptr);
+    this->fitness = reader.read<double>();
+    this->metric_value = 0.0;
+    this->evaluation_key = 0;
+    this->inherits_fitness = false;
+    this->inheritance_reason = InheritanceReason::None;
+    this->dirty_genes.clear();
+    this->parent_hash = 0;
+    runtime_assert(genes.size() == reader.read<std::int32_t>(), "The number of genes does not match the config.");
+    for (auto &gene : genes)
     {
-        this->genes[i]->deserialize(genes[i].get<picojson::object>(), config);
+        gene->decode(reader, config);
+        gene->update_hash();
     }
+    this->genes.assign(genes.begin(), genes.end());
+    this->update_hash();
 }
 
 template <typename T, typename Container>
@@ -175,7 +423,7 @@ void Genome::savefig(const char *path, const GNPConfig &config) const
         stream << ';' << std::endl;
 
         auto source = gene->index;
-        for (auto pair : gene->branches)
+        for (auto pair : gene->branches.items())
         {
             auto target = gene->targets[pair.second];
             auto &attribute = config.input_attributes[gene->source];
@@ -246,171 +494,94 @@ void Genome::savefig(const char *path, const GNPConfig &config) const
 }
 
 Matrix<data_t> Genome::activate(const Vector<data_t> &vector, const GNPConfig &config) const
+{
+    thread_local std::vector<data_t> buffer;
+    auto cols = config.output_attributes.size();
+    buffer.resize(config.max_num_outputs() * cols);
+
+    auto rows = this->activate(vector.data(), config, buffer.data());
+    Matrix<data_t> outputs(rows, cols);
+    std::copy(buffer.begin(), buffer.begin() + rows * cols, outputs.data());
+    return outputs;
+}
+
+int Genome::activate(const data_t *record, const GNPConfig &config, data_t *outputs) const
 {
     auto remaining_time = config.time_limit;
     const auto *current_node = this->genes.front().get();
-    auto outputs = std::list<data_t>();
+    auto cols = static_cast<int>(config.output_attributes.size());
+    auto capacity = config.max_num_outputs();
+    auto rows = 0;
 
     while (0 < remaining_time)
     {
-        assert(current_node->owner == this);
         if (typeid(*current_node) == typeid(ProcessingNodeGene))
         {
             auto &output = static_cast<const ProcessingNodeGene *>(current_node)->value;
-            outputs.insert(outputs.end(), output.data(), output.data() + output.size());
+            assert(output.size() == cols, "Output size is not matched.");
+            // (実行時間が設定と異なる個体は上限値を超えるため、リリースビルドでも確認します。)
+            if (capacity <= rows)
+                runtime_assert(false, "Number of outputs exceeds the capacity.");
+            std::copy(output.data(), output.data() + cols, outputs + rows * cols);
+            rows++;
         }
         remaining_time -= current_node->delay;
-        current_node = current_node->next(vector);
+        auto next = current_node->next(record);
+        assert(next < this->genes.size(), "Index is out of range.");
+        current_node = this->genes[next].get();
     }
-
-    auto cols = config.output_attributes.size();
-    auto rows = outputs.size() / cols;
-    assert(rows * cols == outputs.size());
-    Matrix<data_t> _outputs(rows, cols);
-    std::copy(outputs.begin(), outputs.end(), _outputs.data());
-    return _outputs;
+    return rows;
 }
 
-static Vector<data_t> pyvec2cppvec(const DataAttributeCollection &attributes, boost::python::numpy::ndarray vector_py)
+std::vector<Matrix<data_t>> Genome::activate_batch(const Matrix<data_t> &matrix, const GNPConfig &config, ActivationMode mode) const
 {
-    namespace py = boost::python;
-    namespace np = boost::python::numpy;
-
-    auto ndim = vector_py.get_nd();
-    runtime_assert(ndim == 1, "ndim must be 1.");
-
-    auto dims = py::len(vector_py);
-    runtime_assert(attributes.size() == dims, "vector_py dimension do not match the length of attributes.");
-
-    Vector<data_t> vector(dims);
-
-    std::vector<DataAttributeType> types(dims);
-    std::transform(attributes.begin(), attributes.end(), types.begin(), [](auto &attr) { return attr.type; });
-
-    auto copy = [&attributes](const auto *source, data_t *dest) {
-        int dims = attributes.size();
-        for (int index = 0; index < dims; index++)
-        {
-            auto type = attributes[index].type;
-            switch (type)
-            {
-            case DataAttributeType::Category:
-                dest[index].category = (category_t)source[index];
-                break;
-            case DataAttributeType::Numeric:
-                dest[index].numeric = (numeric_t)source[index];
-                break;
-            default:
-                runtime_assert(false);
-                break;
-            }
-        }
-    };
-
-    auto translate = [&attributes](boost::python::numpy::ndarray source, data_t *dest) {
-        int dims = attributes.size();
-        for (int index = 0; index < dims; index++)
-        {
-            auto type = attributes[index].type;
-            switch (type)
-            {
-            case DataAttributeType::Category:
-                dest[index].category = (category_t)py::extract<category_t>(source[index]);
-                break;
-            case DataAttributeType::Numeric:
-                dest[index].numeric = (numeric_t)py::extract<numeric_t>(source[index]);
-                break;
-            default:
-                runtime_assert(false);
-                break;
-            }
-        }
-    };
-
-    auto dtype = vector_py.get_dtype();
-    if (dtype == np::dtype::get_builtin<int8_t>())
-    {
-        auto source = reinterpret_cast<const int8_t *>(vector_py.get_data());
-        copy(source, vector.data());
-    }
-    else if (dtype == np::dtype::get_builtin<int16_t>())
-    {
-        auto source = reinterpret_cast<const int16_t *>(vector_py.get_data());
-        copy(source, vector.data());
-    }
-    else if (dtype == np::dtype::get_builtin<int32_t>())
-    {
-        auto source = reinterpret_cast<const int32_t *>(vector_py.get_data());
-        copy(source, vector.data());
-    }
-    else if (dtype == np::dtype::get_builtin<int64_t>())
-    {
-        auto source = reinterpret_cast<const int64_t *>(vector_py.get_data());
-        copy(source, vector.data());
-    }
-    else if (dtype == np::dtype::get_builtin<float32_t>())
-    {
-        auto source = reinterpret_cast<const float32_t *>(vector_py.get_data());
-        copy(source, vector.data());
-    }
-    else if (dtype == np::dtype::get_builtin<float64_t>())
-    {
-        auto source = reinterpret_cast<const float64_t *>(vector_py.get_data());
-        copy(source, vector.data());
-    }
-    else
-    {
-        // runtime_assert(false, "dtype must be int32, int64, float32, or float64.");
-        translate(vector_py, vector.data());
-    }
-
-    return vector;
+    // レコード数が多いため、平坦化した表現に変換してからノード遷移を行います。
+    return CompiledGenome(*this, config).activate_batch(matrix, config, mode);
 }
 
-static boost::python::numpy::ndarray cppmat2pymat(const DataAttributeCollection &attributes, const Matrix<data_t> &mat)
+boost::python::numpy::ndarray Genome::activate_py(boost::python::numpy::ndarray vector_py, const GNPConfig &config) const
 {
-    namespace py = boost::python;
-    namespace np = boost::python::numpy;
-
-    auto rows = mat.rows();
-    auto cols = mat.cols();
-    auto shape = py::make_tuple(rows, cols);
-    auto dtype = np::dtype::get_builtin<double>();
-    auto mat_py = np::zeros(shape, dtype);
-    auto mat_py_ = Eigen::Map<Matrix<double>>(reinterpret_cast<double *>(mat_py.get_data()), rows, cols);
+    auto input = pyvec2cppvec(config.input_attributes, vector_py);
+    auto output = cppmat2pymat(config.output_attributes, this->activate(input, config));
+    return output;
+}
 
-    for (int i = 0; i < mat.rows(); i++)
-    {
-        for (int j = 0; j < mat.cols(); j++)
-        {
-            auto type = attributes[j].type;
-            switch (type)
-            {
-            case DataAttributeType::Category:
-                mat_py_(i, j) = (double)mat(i, j).category;
-                break;
-            case DataAttributeType::Numeric:
-                mat_py_(i, j) = (double)mat(i, j).numeric;
-                break;
-            default:
-                runtime_assert(false);
-                break;
-            }
-        }
-    }
+int Genome::activate_into_py(boost::python::numpy::ndarray vector_py, const GNPConfig &config, boost::python::numpy::ndarray out) const
+{
+    thread_local std::vector<data_t> input;
+    thread_local std::vector<data_t> output;
+    input.resize(config.input_attributes.size());
+    output.resize(config.max_num_outputs() * config.output_attributes.size());
+
+    pyvec2cppvec(config.input_attributes, vector_py, input.data());
+    auto rows = this->activate(input.data(), config, output.data());
+    cppbuf2pymat(config.output_attributes, output.data(), rows, out);
+    return rows;
+}
 
-    return mat_py;
+boost::python::numpy::ndarray Genome::activate_batch_py(boost::python::numpy::ndarray matrix_py, const GNPConfig &config, const std::string &mode) const
+{
+    return this->activate_batch_py(Dataset(matrix_py, config.input_attributes), config, mode);
 }
 
-boost::python::numpy::ndarray Genome::activate_py(boost::python::numpy::ndarray vector_py, const GNPConfig &config) const
+boost::python::numpy::ndarray Genome::activate_batch_py(const Dataset &dataset, const GNPConfig &config, const std::string &mode) const
 {
-    auto input = pyvec2cppvec(config.input_attributes, vector_py);
-    auto output = cppmat2pymat(config.output_attributes, this->activate(input, config));
-    return output;
+    dataset.validate(config, false);
+    auto activation_mode = to_activation_mode(mode);
+    std::vector<Matrix<data_t>> outputs;
+    {
+        ScopedGILRelease release;
+        outputs = this->activate_batch(dataset.inputs, config, activation_mode);
+    }
+    return cppbatch2pyarray(config.output_attributes, outputs);
 }
 
 bool Genome::equal_to(const Genome &other) const
 {
+    // (ハッシュ値が異なる個体は内容も異なります。)
+    if (this->hash != other.hash)
+        return false;
+
     auto &group1 = this->genes;
     auto &group2 = other.genes;
     if (group1.size() == group2.size())
@@ -420,7 +591,7 @@ bool Genome::equal_to(const Genome &other) const
         return std::all_of(indices.begin(), indices.end(), [&group1, &group2](int index) {
             auto &instance1 = group1[index];
             auto &instance2 = group2[index];
-            return instance1->equal_to(instance2.get());
+            return instance1 == instance2 || (instance1->hash == instance2->hash && instance1->equal_to(instance2.get()));
         });
     }
     return false;
@@ -428,6 +599,9 @@ bool Genome::equal_to(const Genome &other) const
 
 bool Genome::not_equal_to(const Genome &other) const
 {
+    if (this->hash != other.hash)
+        return true;
+
     auto &group1 = this->genes;
     auto &group2 = other.genes;
     if (group1.size() == group2.size())
@@ -437,35 +611,47 @@ bool Genome::not_equal_to(const Genome &other) const
         return std::any_of(indices.begin(), indices.end(), [&group1, &group2](int index) {
             auto &instance1 = group1[index];
             auto &instance2 = group2[index];
-            return instance1->not_equal_to(instance2.get());
+            return instance1 != instance2 && (instance1->hash != instance2->hash || instance1->not_equal_to(instance2.get()));
         });
     }
     return true;
 }
 
-void Genome::allocate_memory(const GNPConfig &config)
+template <typename T>
+static std::shared_ptr<AbstractNodeGene> create_gene(int index, const GNPConfig &config, GenePool *pool)
+{
+    if (pool)
+        return pool->create<T>(index, config);
+    return std::make_shared<T>(index, config);
+}
+
+std::vector<std::shared_ptr<AbstractNodeGene>> Genome::allocate_memory(const GNPConfig &config, GenePool *pool)
 {
-    auto num_genes = 1 + config.num_category_judgement_nodes + config.num_numeric_judgement_nodes + config.num_processing_nodes; // '1' means initial node.
+    if (pool)
+        pool->recycle(*this);
     this->genes.clear();
-    this->genes.reserve(num_genes);
+
+    auto genes = std::vector<std::shared_ptr<AbstractNodeGene>>();
+    genes.reserve(config.num_genes());
     {
-        auto index = this->genes.size();
-        this->genes.emplace_back(new InitialNodeGene(this, index, config));
+        auto index = static_cast<int>(genes.size());
+        genes.push_back(create_gene<InitialNodeGene>(index, config, pool));
     }
     for (int i = 0; i < config.num_category_judgement_nodes; i++)
     {
-        auto index = this->genes.size();
-        this->genes.emplace_back(new CategoryJudgementNodeGene(this, index, config));
+        auto index = static_cast<int>(genes.size());
+        genes.push_back(create_gene<CategoryJudgementNodeGene>(index, config, pool));
     }
     for (int i = 0; i < config.num_numeric_judgement_nodes; i++)
     {
-        auto index = this->genes.size();
-        this->genes.emplace_back(new NumericJudgementNodeGene(this, index, config));
+        auto index = static_cast<int>(genes.size());
+        genes.push_back(create_gene<NumericJudgementNodeGene>(index, config, pool));
     }
     for (int i = 0; i < config.num_processing_nodes; i++)
     {
-        auto index = this->genes.size();
-        this->genes.emplace_back(new ProcessingNodeGene(this, index, config));
+        auto index = static_cast<int>(genes.size());
+        genes.push_back(create_gene<ProcessingNodeGene>(index, config, pool));
     }
+    return genes;
 }
 }
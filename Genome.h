@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <picojson.h>
@@ -8,30 +10,49 @@
 #include <boost/python.hpp>
 #include <boost/python/numpy.hpp>
 
+#include "ActivationMode.h"
+#include "Dataset.h"
 #include "GNPConfig.h"
 #include "GNPTypes.h"
 #include "NodeGene.h"
 
 namespace gnp
 {
+class GenePool;
+
+// 親個体の適合度を引き継げる理由。
+enum class InheritanceReason
+{
+    None,              // 引き継げません。
+    Unchanged,         // 親個体から変更されていません。
+    UnreachableChanges // 変更されたノードがすべて、制限時間内に遷移開始ノードから到達できません。
+};
+
 // 遺伝子を表します。
 class Genome
 {
   public:
     // ランダムに新しい個体を生成します。
-    void configure_new(randomizer_t &randomizer, const GNPConfig &config);
+    void configure_new(randomizer_t &randomizer, const GNPConfig &config, GenePool *pool = nullptr);
 
-    // 親個体からパラメータを引き継ぎます。
-    void configure_inheritance(const Genome &parent);
+    // 親個体からパラメータを引き継ぎます(ノードは親個体と共有します。pool を指定した場合は、現在のノードをプールに戻します)。
+    void configure_inheritance(const Genome &parent, GenePool *pool = nullptr);
 
     // 親個体からパラメータを引き継ぎます。
     void configure_inheritance_move(Genome &&parent);
 
+    // 個体をそのまま複製します(適合度を引き継げるかどうかや dirty_genes も複製元と同じにします)。
+    void configure_copy(const Genome &source);
+
     // 2 つの親個体を交叉して新しい遺伝子を生成します。
-    void configure_crossover(randomizer_t &randomizer, const Genome &parent1, const Genome &parent2);
+    void configure_crossover(randomizer_t &randomizer, const Genome &parent1, const Genome &parent2, GenePool *pool = nullptr);
 
-    // 突然変異を行います。
-    void mutate(randomizer_t &randomizer, const GNPConfig &config);
+    // 2 つの親個体を交叉して新しい遺伝子を生成し、いずれかの親個体の適合度を引き継げるかどうかを調べます。
+    void configure_crossover(randomizer_t &randomizer, const Genome &parent1, const Genome &parent2, const GNPConfig &config, GenePool *pool = nullptr);
+
+    // 突然変異を行います。戻り値はいずれかのノードを変更したかどうかです。
+    // 変更したノードだけを複製して差し替えます(pool を指定した場合は、プールのノードを再利用します)。
+    bool mutate(randomizer_t &randomizer, const GNPConfig &config, GenePool *pool = nullptr);
 
     // 指定されたファイルに個体情報を保存します。
     void serialize(const char *path, const GNPConfig &config) const;
@@ -43,15 +64,39 @@ class Genome
 
     void deserialize_from_object(const picojson::object &object, const GNPConfig &config);
 
+    // 適合度と全ノードの内容をバイト列に書き込みます(ファイルへの保存よりも小さい、プロセス間の受け渡し用の形式です)。
+    void encode(BinaryWriter &writer, const GNPConfig &config) const;
+
+    // encode で書き込んだバイト列から個体を復元します。
+    void decode(BinaryReader &reader, const GNPConfig &config);
+
     // ネットワーク図を画像ファイルに出力します。
     void savefig(const char *path, const GNPConfig &config) const;
 
     // ノード遷移を行います。
     Matrix<data_t> activate(const Vector<data_t> &vector, const GNPConfig &config) const;
 
+    // ノード遷移を行い、出力値を outputs に行優先で書き込みます。戻り値は出力した回数(行数)です。
+    // outputs には config.max_num_outputs() * 出力属性数 個の領域が必要です(ヒープ領域の確保は行いません)。
+    int activate(const data_t *record, const GNPConfig &config, data_t *outputs) const;
+
     // ノード遷移を行います。
     boost::python::numpy::ndarray activate_py(boost::python::numpy::ndarray vector, const GNPConfig &config) const;
 
+    // ノード遷移を行い、出力値を out (float64, 形状は (config.max_num_outputs, 出力属性数)) に書き込みます。
+    // 戻り値は出力した回数(行数)です。
+    int activate_into_py(boost::python::numpy::ndarray vector, const GNPConfig &config, boost::python::numpy::ndarray out) const;
+
+    // 全レコード(行)に対してノード遷移を行います。
+    std::vector<Matrix<data_t>> activate_batch(const Matrix<data_t> &matrix, const GNPConfig &config, ActivationMode mode = ActivationMode::Auto) const;
+
+    // 全レコード(行)に対してノード遷移を行います。
+    // 結果は (レコード数, 最大出力回数, 出力属性数) の配列で、出力がない箇所は NaN で埋められます。
+    boost::python::numpy::ndarray activate_batch_py(boost::python::numpy::ndarray matrix, const GNPConfig &config, const std::string &mode) const;
+
+    // データセットの全レコードに対してノード遷移を行います。
+    boost::python::numpy::ndarray activate_batch_py(const Dataset &dataset, const GNPConfig &config, const std::string &mode) const;
+
   public:
     Genome() = default;
 
@@ -69,7 +114,7 @@ class Genome
     {
         if (this != &source)
         {
-            this->configure_inheritance(source);
+            this->configure_copy(source);
         }
         return *this;
     }
@@ -95,25 +140,61 @@ class Genome
         this->configure_crossover(randomizer, parent1, parent2);
     }
 
-    void mutate_py(const GNPConfig &config)
+    bool mutate_py(const GNPConfig &config)
     {
         auto randomizer = randomizer_t(std::random_device()());
-        this->mutate(randomizer, config);
+        return this->mutate(randomizer, config);
     }
 
     bool equal_to(const Genome &other) const;
 
     bool not_equal_to(const Genome &other) const;
 
+    // 個体のハッシュ値を全ノードのハッシュ値から再計算します(ノードを直接変更した場合に使用します)。
+    void update_hash();
+
+    // 制限時間内に遷移開始ノードから到達し得るノードを求めます(要素はノードのインデックスに対応します)。
+    std::vector<bool> reachable_genes(const GNPConfig &config) const;
+
+    // 親個体の適合度を引き継げる理由を文字列("none", "unchanged", "unreachable_changes")で取得します。
+    std::string get_inheritance_reason() const;
+
   private:
-    void allocate_memory(const GNPConfig &config);
+    // 現在のノードを手放し、設定に従って新しいノードを作成します(作成したノードは呼び出し側で初期化して格納します)。
+    std::vector<std::shared_ptr<AbstractNodeGene>> allocate_memory(const GNPConfig &config, GenePool *pool);
+
+    // 制限時間内に遷移開始ノードから到達し得るノードを reachable に格納します。
+    void find_reachable_genes(const GNPConfig &config, std::vector<bool> &reachable) const;
+
+    // 親個体から変更されたノードが到達可能かどうかを調べ、適合度を引き継げるかどうかを更新します。
+    void update_inheritance(const GNPConfig &config);
 
   public:
     // フィットネス値。
     double fitness;
 
     // ネットワークを構成するノードの集合。
-    std::vector<std::unique_ptr<AbstractNodeGene>> genes;
+    // ノードは変更されないため、親個体と子個体の間で共有されます。
+    std::vector<std::shared_ptr<const AbstractNodeGene>> genes;
+
+    // 全ノードのハッシュ値の排他的論理和(Zobrist hashing)。内容が同じ個体は同じ値になります。
+    // 突然変異や交叉では、変更されたノードの分だけ差分で更新されます。
+    std::uint64_t hash = 0;
+
+    // 親個体の適合度(fitness, metric_value)を引き継げるかどうかと、その理由。
+    // 突然変異・交叉で変更されたノードが制限時間内に到達できない場合は、出力が親個体と同じになるため再評価は不要です。
+    bool inherits_fitness = false;
+    InheritanceReason inheritance_reason = InheritanceReason::None;
+
+    // 評価指標の値と、その評価の設定のハッシュ値(未評価の場合は 0)。
+    double metric_value = 0.0;
+    std::uint64_t evaluation_key = 0;
+
+    // 親個体から変更されたノード(要素はノードのインデックスに対応します。追跡していない場合は空です)。
+    std::vector<bool> dirty_genes;
+
+    // dirty_genes の基準とした親個体のハッシュ値(親個体のノード遷移の経路を引くために使用します)。
+    std::uint64_t parent_hash = 0;
 
   public:
     friend bool operator==(const Genome &a, const Genome &b)
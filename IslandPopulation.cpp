@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include "IslandPopulation.h"
+#include "ScopedGILRelease.h"
+#include "Selection.h"
+#include "ThreadPool.h"
+#include "hash.h"
+#include "runtime_assert.h"
+
+namespace gnp
+{
+IslandPopulation::IslandPopulation(const GNPConfig &config, int num_islands, int migration_interval, int num_migrants)
+    : migration_interval(migration_interval), num_migrants(num_migrants)
+{
+    runtime_assert(0 < num_islands, "Number of islands must be greater than 0.");
+    runtime_assert(0 < migration_interval, "Migration interval must be greater than 0.");
+    runtime_assert(0 <= num_migrants && num_migrants <= config.num_genomes, "Number of migrants is out of range.");
+
+    // シードが指定されている場合は、島ごとに異なるシードを導出します。
+    this->configs.reserve(num_islands);
+    this->islands.reserve(num_islands);
+    for (int i = 0; i < num_islands; i++)
+    {
+        this->configs.push_back(config);
+        if (0 <= config.seed)
+            this->islands.emplace_back(config, hash_combine(static_cast<std::uint64_t>(config.seed), i));
+        else
+            this->islands.emplace_back(config);
+    }
+
+    this->statistics.resize(num_islands);
+}
+
+void IslandPopulation::evolve(const Dataset &dataset, const Metric &metric, int num_generations, ActivationMode mode)
+{
+    runtime_assert(0 < this->migration_interval, "Migration interval must be greater than 0.");
+    runtime_assert(0 <= this->num_migrants, "Number of migrants must not be negative.");
+    for (auto &config : this->configs)
+        metric.validate(config.output_attributes);
+
+    // 移住の間隔ごとに区切って進化させます。
+    // (スレッド数が島の数より少ない場合でも、島の間の世代の差が移住の間隔を超えないようにします。)
+    // 移住は区切りの間で呼び出し元のスレッドが決まった順に行うため、シードが同じであればスレッド数によらず同じ結果になります。
+    auto thread_pool = ThreadPool::instance(this->configs.front().num_threads);
+    auto num_islands = this->get_num_islands();
+    for (int done = 0; done < num_generations;)
+    {
+        auto generation = this->islands.front().generation;
+        auto count = std::min(
+            this->migration_interval - static_cast<int>(generation % this->migration_interval), num_generations - done);
+        auto migrating = (generation + count) % this->migration_interval == 0 && 0 < this->num_migrants;
+
+        // (移住する区切りでは、最後の世代の評価の後で移住させてから世代を更新します。)
+        thread_pool->parallel_for(0, num_islands, [&](int index, int worker) {
+            for (int k = 0; k < count; k++)
+            {
+                this->evaluate(index, dataset, metric, mode);
+                if (k + 1 < count || !migrating)
+                    this->islands[index].run(this->configs[index]);
+            }
+        });
+        if (migrating)
+        {
+            this->migrate();
+            thread_pool->parallel_for(0, num_islands, [&](int index, int worker) { this->islands[index].run(this->configs[index]); });
+        }
+        done += count;
+    }
+    thread_pool->parallel_for(0, num_islands, [&](int index, int worker) { this->evaluate(index, dataset, metric, mode); });
+}
+
+void IslandPopulation::migrate()
+{
+    auto num_islands = this->get_num_islands();
+
+    // 先に全ての島から、適合度の上位の個体を選んでおきます(適合度が同じ場合は添字の小さい個体を優先します)。
+    auto emigrants = std::vector<std::vector<Genome>>(num_islands);
+    for (int i = 0; i < num_islands; i++)
+    {
+        auto &genomes = this->islands[i].genomes;
+        auto order = std::vector<int>(genomes.size());
+        std::iota(order.begin(), order.end(), 0);
+        auto count = std::min(this->num_migrants, static_cast<int>(order.size()));
+        std::partial_sort(order.begin(), order.begin() + count, order.end(), [&genomes](int a, int b) {
+            auto fa = genomes[a].fitness;
+            auto fb = genomes[b].fitness;
+            return is_better_fitness(fa, fb) || (!is_better_fitness(fb, fa) && a < b);
+        });
+        // (移住先でも同じ設定で評価する場合は再評価を省略できるよう、子個体として引き継ぎます。)
+        emigrants[i].resize(count);
+        for (int j = 0; j < count; j++)
+            emigrants[i][j].configure_inheritance(genomes[order[j]]);
+        this->statistics[i].migrants_sent += count;
+    }
+
+    // 島 i の個体を島 (i + 1) % 島数 へ移住させ、適合度の低い個体と置き換えます(NaN は最も低いとみなします)。
+    for (int i = 0; i < num_islands; i++)
+    {
+        auto destination = (i + 1) % num_islands;
+        auto &genomes = this->islands[destination].genomes;
+        auto order = std::vector<int>(genomes.size());
+        std::iota(order.begin(), order.end(), 0);
+        auto count = std::min(emigrants[i].size(), order.size());
+        std::partial_sort(order.begin(), order.begin() + count, order.end(), [&genomes](int a, int b) {
+            auto fa = genomes[a].fitness;
+            auto fb = genomes[b].fitness;
+            return is_better_fitness(fb, fa) || (!is_better_fitness(fa, fb) && a < b);
+        });
+        for (size_t j = 0; j < count; j++)
+            genomes[order[j]] = std::move(emigrants[i][j]);
+        this->statistics[destination].migrants_received += count;
+    }
+}
+
+void IslandPopulation::evaluate(int index, const Dataset &dataset, const Metric &metric, ActivationMode mode)
+{
+    auto &island = this->islands[index];
+    auto &statistics = this->statistics[index];
+    island.evaluate(dataset, this->configs[index], metric, mode);
+
+    auto &genomes = island.genomes;
+    auto best = -std::numeric_limits<double>::infinity();
+    auto sum = 0.0;
+    auto count = 0;
+    for (auto &genome : genomes)
+    {
+        if (std::isnan(genome.fitness))
+            continue;
+        best = std::max(best, genome.fitness);
+        sum += genome.fitness;
+        count++;
+    }
+    statistics.best_fitness = best;
+    statistics.mean_fitness = 0 < count ? sum / count : std::numeric_limits<double>::quiet_NaN();
+    statistics.generation = island.generation;
+}
+
+void IslandPopulation::evolve_py(
+    const Dataset &dataset,
+    int num_generations,
+    const std::string &metric_name,
+    const std::string &transform,
+    double scale,
+    double no_output_value,
+    const std::string &mode)
+{
+    dataset.validate(this->configs.front(), true);
+    auto metric = Metric(metric_name, transform, scale, no_output_value);
+    auto activation_mode = to_activation_mode(mode);
+    ScopedGILRelease release;
+    this->evolve(dataset, metric, num_generations, activation_mode);
+}
+
+void IslandPopulation::evolve_py(
+    boost::python::numpy::ndarray inputs_py,
+    boost::python::numpy::ndarray targets_py,
+    int num_generations,
+    const std::string &metric,
+    const std::string &transform,
+    double scale,
+    double no_output_value,
+    const std::string &mode)
+{
+    auto &config = this->configs.front();
+    auto dataset = Dataset(inputs_py, config.input_attributes, targets_py, config.output_attributes);
+    this->evolve_py(dataset, num_generations, metric, transform, scale, no_output_value, mode);
+}
+
+int IslandPopulation::get_num_islands() const
+{
+    return static_cast<int>(this->islands.size());
+}
+
+Population &IslandPopulation::get_island(int index)
+{
+    runtime_assert(0 <= index && index < this->get_num_islands(), "Island index is out of range.");
+    return this->islands[index];
+}
+
+GNPConfig &IslandPopulation::get_config(int index)
+{
+    runtime_assert(0 <= index && index < this->get_num_islands(), "Island index is out of range.");
+    return this->configs[index];
+}
+
+Genome IslandPopulation::get_best_genome() const
+{
+    const Genome *best = nullptr;
+    for (auto &island : this->islands)
+    {
+        for (auto &genome : island.genomes)
+        {
+            if (!best || is_better_fitness(genome.fitness, best->fitness))
+                best = &genome;
+        }
+    }
+    runtime_assert(best != nullptr, "Population is empty.");
+    return *best;
+}
+}
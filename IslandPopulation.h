@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+
+#include "ActivationMode.h"
+#include "Dataset.h"
+#include "GNPConfig.h"
+#include "Genome.h"
+#include "Metric.h"
+#include "Population.h"
+
+namespace gnp
+{
+// 1 つの島の統計情報です。
+struct IslandStatistics
+{
+    // 島の世代。
+    std::uint64_t generation = 0;
+
+    // 直近の評価における適合度の最大値と平均値(NaN の個体は除きます)。
+    double best_fitness = 0.0;
+    double mean_fitness = 0.0;
+
+    // 送り出した個体の数と、受け入れた個体の数。
+    long long migrants_sent = 0;
+    long long migrants_received = 0;
+
+    // 全ての値が等しい場合に等しいとみなします。
+    friend bool operator==(const IslandStatistics &a, const IslandStatistics &b)
+    {
+        return a.generation == b.generation && a.best_fitness == b.best_fitness && a.mean_fitness == b.mean_fitness &&
+               a.migrants_sent == b.migrants_sent && a.migrants_received == b.migrants_received;
+    }
+};
+
+// 複数の個体群(島)を独立に進化させ、一定の世代ごとに優れた個体を隣の島へ移住させる島モデルです。
+// 各島は共有のスレッドプールのタスクとして並列に進化し、島の中の評価などはそのスレッドプールで入れ子に並列化されます。
+// 島 i は島 (i + 1) % 島数 に移住させ、移住は全ての島が同じ世代に揃ったところで呼び出し元のスレッドが行います。
+class IslandPopulation
+{
+  public:
+    // config をもとに num_islands 個の島を作成します(各島の個体数は config.num_genomes です)。
+    // migration_interval 世代ごとに、各島の適合度の上位 num_migrants 個の個体を隣の島へ送り出します。
+    IslandPopulation(const GNPConfig &config, int num_islands, int migration_interval = 10, int num_migrants = 1);
+
+    // 各島を num_generations 世代進化させます。
+    // 各世代では 評価、世代の更新 の順に行い、移住する世代では評価の後で全ての島の上位の個体を隣の島の適合度の低い個体と置き換えてから世代を更新します。
+    // 最後に各島を評価します。
+    void evolve(const Dataset &dataset, const Metric &metric, int num_generations, ActivationMode mode = ActivationMode::Auto);
+
+    // 各島を num_generations 世代進化させます(進化の間は GIL を解放します)。
+    void evolve_py(
+        const Dataset &dataset,
+        int num_generations,
+        const std::string &metric,
+        const std::string &transform,
+        double scale,
+        double no_output_value,
+        const std::string &mode);
+
+    // 各島を num_generations 世代進化させます(進化の間は GIL を解放します)。
+    void evolve_py(
+        boost::python::numpy::ndarray inputs,
+        boost::python::numpy::ndarray targets,
+        int num_generations,
+        const std::string &metric,
+        const std::string &transform,
+        double scale,
+        double no_output_value,
+        const std::string &mode);
+
+    // 島の数を取得します。
+    int get_num_islands() const;
+
+    // 島 index の個体群を取得します。
+    Population &get_island(int index);
+
+    // 島 index の設定を取得します(変更すると、以降の進化でその島の突然変異率などに反映されます)。
+    GNPConfig &get_config(int index);
+
+    // 全島の評価済みの個体のうち、適合度が最も高い個体を取得します。
+    Genome get_best_genome() const;
+
+  public:
+    // 島ごとの統計情報。
+    std::vector<IslandStatistics> statistics;
+
+    // 移住させる世代の間隔と、1 回に移住させる個体の数。
+    int migration_interval;
+    int num_migrants;
+
+  private:
+    // 各島の適合度の上位の個体を、隣の島へ移住させます。
+    void migrate();
+
+    // 島 index の評価を行い、統計情報を更新します。
+    void evaluate(int index, const Dataset &dataset, const Metric &metric, ActivationMode mode);
+
+    std::vector<GNPConfig> configs;
+
+    std::vector<Population> islands;
+};
+}
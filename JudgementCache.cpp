@@ -0,0 +1,87 @@
+#include "JudgementCache.h"
+
+namespace gnp
+{
+void JudgementCache::prepare(const Dataset &dataset)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->dataset_id != dataset.id)
+    {
+        this->tables.clear();
+        this->bytes = 0;
+        this->dataset_id = dataset.id;
+    }
+}
+
+JudgementCache::table_t JudgementCache::get(const CompiledGenome &genome, int node, const Dataset &dataset)
+{
+    auto signature = genome.judgement_signature(node);
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->tables.find(signature);
+        if (it != this->tables.end())
+        {
+            this->hits++;
+            return it->second;
+        }
+        this->misses++;
+        if (this->max_bytes < this->bytes + dataset.num_records())
+            return nullptr;
+    }
+
+    // (計算中はロックを解放します。同じ表を複数のスレッドが同時に計算した場合は、先に登録された表を使用します。)
+    auto &inputs = dataset.inputs;
+    auto table = std::make_shared<std::vector<uint8_t>>(inputs.rows());
+    genome.compute_branch_table(node, inputs.data(), inputs.rows(), inputs.cols(), table->data());
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = this->tables.find(signature);
+    if (it != this->tables.end())
+        return it->second;
+    if (this->bytes + static_cast<long long>(table->size()) <= this->max_bytes)
+    {
+        this->bytes += table->size();
+        this->tables.emplace(std::move(signature), table);
+    }
+    return table;
+}
+
+void JudgementCache::clear()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->tables.clear();
+    this->bytes = 0;
+    this->dataset_id = 0;
+}
+
+void JudgementCache::reset_statistics()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->hits = 0;
+    this->misses = 0;
+}
+
+long long JudgementCache::get_hits() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->hits;
+}
+
+long long JudgementCache::get_misses() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->misses;
+}
+
+int JudgementCache::get_size() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return static_cast<int>(this->tables.size());
+}
+
+long long JudgementCache::get_bytes() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->bytes;
+}
+}
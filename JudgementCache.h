@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CompiledGenome.h"
+#include "Dataset.h"
+
+namespace gnp
+{
+// 個体群の評価で、同じ判定ノード(種類、入力元、パラメータが同じノード)のブランチの表を共有するキャッシュです。
+// 表はデータセット全体のレコードに対するブランチのインデックスで、個体群の評価ごとに 1 度だけ計算されます。
+// 異なるデータセットで評価した場合と、世代を更新した場合に破棄されます。
+class JudgementCache
+{
+  public:
+    typedef std::shared_ptr<const std::vector<uint8_t>> table_t;
+
+    JudgementCache() = default;
+
+    // (複製では内容を引き継ぎません。)
+    JudgementCache(const JudgementCache &)
+    {
+    }
+
+    JudgementCache &operator=(const JudgementCache &)
+    {
+        this->clear();
+        return *this;
+    }
+
+    // データセットが前回と異なる場合は、キャッシュを破棄します。
+    void prepare(const Dataset &dataset);
+
+    // 判定ノード node のデータセット全体に対するブランチの表を取得します(キャッシュにない場合は計算して登録します)。
+    // 登録されている表の合計バイト数が上限に達している場合は nullptr を返します。
+    table_t get(const CompiledGenome &genome, int node, const Dataset &dataset);
+
+    // キャッシュを破棄します(統計情報は保持されます)。
+    void clear();
+
+    // 統計情報を初期化します。
+    void reset_statistics();
+
+    long long get_hits() const;
+
+    long long get_misses() const;
+
+    // 登録されている表の数を取得します。
+    int get_size() const;
+
+    // 登録されている表の合計バイト数を取得します。
+    long long get_bytes() const;
+
+  public:
+    // 登録する表の合計バイト数の上限。
+    long long max_bytes = 256LL << 20;
+
+  private:
+    mutable std::mutex mutex;
+
+    std::unordered_map<std::string, table_t> tables;
+
+    std::uint64_t dataset_id = 0;
+
+    long long hits = 0;
+
+    long long misses = 0;
+
+    long long bytes = 0;
+};
+}
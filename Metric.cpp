@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Metric.h"
+#include "format.h"
+#include "runtime_assert.h"
+
+namespace gnp
+{
+static MetricType to_metric_type(std::string name)
+{
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (name == "mse" || name == "mean_squared_error")
+        return MetricType::MeanSquaredError;
+    if (name == "mae" || name == "mean_absolute_error")
+        return MetricType::MeanAbsoluteError;
+    if (name == "accuracy")
+        return MetricType::Accuracy;
+    if (name == "log_loss")
+        return MetricType::LogLoss;
+    runtime_assert(false, format("'{0}' is invalid metric.", name));
+    return MetricType::MeanSquaredError;
+}
+
+static FitnessTransform to_fitness_transform(std::string name, MetricType type)
+{
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (name == "auto")
+        return Metric::default_transform(type);
+    if (name == "identity")
+        return FitnessTransform::Identity;
+    if (name == "negative")
+        return FitnessTransform::Negative;
+    if (name == "reciprocal")
+        return FitnessTransform::Reciprocal;
+    if (name == "negative_log")
+        return FitnessTransform::NegativeLog;
+    runtime_assert(false, format("'{0}' is invalid fitness transform.", name));
+    return FitnessTransform::Identity;
+}
+
+static inline double to_double(DataAttributeType type, data_t data)
+{
+    return type == DataAttributeType::Category ? (double)data.category : (double)data.numeric;
+}
+
+Metric::Metric(MetricType type, FitnessTransform transform, double scale, double no_output_value)
+    : type(type), transform(transform), scale(scale), no_output_value(no_output_value)
+{
+    // (scale が 0 以下の場合、適合度が inf や NaN になるか、大小関係が反転します。)
+    runtime_assert(0 < scale, "Scale must be positive.");
+}
+
+Metric::Metric(const std::string &type, const std::string &transform, double scale, double no_output_value)
+    : Metric(to_metric_type(type), to_fitness_transform(transform, to_metric_type(type)), scale, no_output_value)
+{
+}
+
+FitnessTransform Metric::default_transform(MetricType type)
+{
+    // 誤差は小さいほど良いため、誤差に対して減少する変換方法を使用します。
+    return type == MetricType::Accuracy ? FitnessTransform::Identity : FitnessTransform::Reciprocal;
+}
+
+void Metric::validate(const DataAttributeCollection &attributes) const
+{
+    if (this->type == MetricType::LogLoss)
+    {
+        for (auto &attribute : attributes)
+            runtime_assert(attribute.type == DataAttributeType::Category, "Log loss is only available for category outputs.");
+    }
+}
+
+double Metric::measure(const DataAttributeCollection &attributes, const data_t *outputs, int rows, const data_t *target) const
+{
+    // 出力の 1 行目を推定値とします(出力がない場合は no_output_value を推定値とします)。
+    // ただし、交差エントロピーでは全ての出力を投票とみなしてカテゴリの確率を求めます。
+    auto cols = static_cast<int>(attributes.size());
+    auto value = 0.0;
+    for (int j = 0; j < cols; j++)
+    {
+        auto type = attributes[j].type;
+        auto truth = to_double(type, target[j]);
+        auto estimation = 0 < rows ? to_double(type, outputs[j]) : this->no_output_value;
+        switch (this->type)
+        {
+        case MetricType::MeanSquaredError:
+            value += (estimation - truth) * (estimation - truth);
+            break;
+        case MetricType::MeanAbsoluteError:
+            value += std::abs(estimation - truth);
+            break;
+        case MetricType::Accuracy:
+            value += (estimation == truth) ? 1.0 : 0.0;
+            break;
+        case MetricType::LogLoss:
+        {
+            constexpr double epsilon = 1e-15;
+            auto probability = 0.0;
+            if (0 < rows)
+            {
+                auto votes = 0;
+                for (int k = 0; k < rows; k++)
+                    votes += (to_double(type, outputs[k * cols + j]) == truth) ? 1 : 0;
+                probability = static_cast<double>(votes) / rows;
+            }
+            else
+            {
+                probability = (estimation == truth) ? 1.0 : 0.0;
+            }
+            value += -std::log(std::min(std::max(probability, epsilon), 1.0 - epsilon));
+            break;
+        }
+        }
+    }
+    return value / cols;
+}
+
+double Metric::fitness(double value) const
+{
+    value /= this->scale;
+    switch (this->transform)
+    {
+    case FitnessTransform::Identity:
+        return value;
+    case FitnessTransform::Negative:
+        return -value;
+    case FitnessTransform::Reciprocal:
+        return 1.0 / (1.0 + value);
+    case FitnessTransform::NegativeLog:
+        return -std::log(value);
+    }
+    return value;
+}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+
+#include "DataAttributeCollection.h"
+#include "GNPTypes.h"
+
+namespace gnp
+{
+// 評価指標の種類。
+enum class MetricType
+{
+    MeanSquaredError,  // 平均二乗誤差。
+    MeanAbsoluteError, // 平均絶対誤差。
+    Accuracy,          // 正解率。
+    LogLoss            // 交差エントロピー(カテゴリ属性の出力のみ)。
+};
+
+// 評価指標の値から適合度への変換方法。
+enum class FitnessTransform
+{
+    Identity,   // f(x) = x
+    Negative,   // f(x) = -x
+    Reciprocal, // f(x) = 1 / (1 + x)
+    NegativeLog // f(x) = -log(x)
+};
+
+// 個体の評価方法を表します。
+// 評価指標の値はレコードごとの値の平均として計算されます。
+class Metric
+{
+  public:
+    Metric(MetricType type, FitnessTransform transform, double scale, double no_output_value);
+
+    // 名前('mse', 'mae', 'accuracy', 'log_loss' / 'auto', 'identity', 'negative', 'reciprocal', 'negative_log')から作成します。
+    // 変換方法が 'auto' の場合は、評価指標の種類に応じた変換方法を使用します(default_transform を参照)。
+    Metric(const std::string &type, const std::string &transform, double scale, double no_output_value);
+
+    // 評価指標の値が良いほど適合度が大きくなる変換方法を取得します。
+    // (正解率は 'identity'、誤差は 'reciprocal' です。)
+    static FitnessTransform default_transform(MetricType type);
+
+    // 出力属性に対して評価指標が使用できるかを検証します(交差エントロピーはカテゴリ属性の出力のみです)。
+    void validate(const DataAttributeCollection &attributes) const;
+
+    // 1 つのレコードに対する評価指標の値を計算します(事前に validate で検証しておく必要があります)。
+    // outputs はノード遷移の出力値(rows 行)、target は正解値です。
+    double measure(const DataAttributeCollection &attributes, const data_t *outputs, int rows, const data_t *target) const;
+
+    // 評価指標の値を適合度に変換します(値は scale で割ってから変換されます)。
+    double fitness(double value) const;
+
+  public:
+    // 評価指標の種類。
+    MetricType type;
+
+    // 適合度への変換方法。
+    FitnessTransform transform;
+
+    // 適合度へ変換する前に評価指標の値を割る値。
+    double scale;
+
+    // 処理ノードを 1 度も通らなかった場合に、出力されたとみなす値。
+    double no_output_value;
+};
+}
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cmath>
+
+#include "MutationSampler.h"
+
+namespace gnp
+{
+// num_sites 個の箇所のそれぞれを確率 rate で選び、選んだ箇所のインデックスを昇順に emit に渡します。
+template <typename F>
+static void sample_sites(randomizer_t &randomizer, double rate, long long num_sites, F &&emit)
+{
+    if (rate <= 0.0 || num_sites <= 0)
+        return;
+    if (1.0 <= rate)
+    {
+        for (long long i = 0; i < num_sites; i++)
+            emit(i);
+        return;
+    }
+
+    // 次に選ぶ箇所までに読み飛ばす数は、成功確率 rate の幾何分布に従います。
+    auto log_q = std::log1p(-rate);
+    auto uniform = std::uniform_real_distribution<double>(0.0, 1.0);
+    auto skip = [&]() {
+        return std::floor(std::log(1.0 - uniform(randomizer)) / log_q);
+    };
+    for (double i = skip(); i < num_sites; i += 1.0 + skip())
+        emit(static_cast<long long>(i));
+}
+
+MutationSampler::MutationSampler(const GNPConfig &config)
+{
+    this->num_category_judgement_nodes = config.num_category_judgement_nodes;
+    this->num_numeric_judgement_nodes = config.num_numeric_judgement_nodes;
+    this->num_processing_nodes = config.num_processing_nodes;
+    this->num_branches = config.num_branches;
+    this->num_outputs = static_cast<int>(config.output_attributes.size());
+
+    this->num_categories = 0;
+    for (auto &attribute : config.input_attributes)
+    {
+        if (attribute.type == DataAttributeType::Category)
+        {
+            auto count = static_cast<long long>(attribute.max.category) - attribute.min.category + 1;
+            this->num_categories = std::max(this->num_categories, count);
+        }
+    }
+
+    this->branch_mutation_rate = config.branch_mutation_rate;
+    this->output_mutation_rate = config.output_mutation_rate;
+    this->data_source_mutation_rate = config.data_source_mutation_rate;
+    this->judgement_function_mutation_rate = config.judgement_function_mutation_rate;
+}
+
+void MutationSampler::sample(randomizer_t &randomizer, std::vector<MutationSite> &sites) const
+{
+    // ノードは 遷移開始ノード, カテゴリ判定ノード, 数値判定ノード, 処理ノード の順に並びます。
+    auto num_judgement_nodes = this->num_category_judgement_nodes + this->num_numeric_judgement_nodes;
+    auto first_judgement = 1;
+    auto first_numeric_judgement = first_judgement + this->num_category_judgement_nodes;
+    auto first_processing = first_judgement + num_judgement_nodes;
+
+    sites.clear();
+
+    // 接続先ノード: 遷移開始ノードと処理ノードは 1 箇所、判定ノードは分岐数の箇所です。
+    auto judgement_branches = static_cast<long long>(num_judgement_nodes) * this->num_branches;
+    sample_sites(randomizer, this->branch_mutation_rate, 1 + judgement_branches + this->num_processing_nodes, [&](long long i) {
+        if (i == 0)
+            sites.push_back({0, MutationSiteType::Branch, 0});
+        else if (i - 1 < judgement_branches)
+            sites.push_back({first_judgement + static_cast<int>((i - 1) / this->num_branches), MutationSiteType::Branch, static_cast<int>((i - 1) % this->num_branches)});
+        else
+            sites.push_back({first_processing + static_cast<int>(i - 1 - judgement_branches), MutationSiteType::Branch, 0});
+    });
+
+    // 出力値: 処理ノードごとに出力属性数の箇所です。
+    sample_sites(randomizer, this->output_mutation_rate, static_cast<long long>(this->num_processing_nodes) * this->num_outputs, [&](long long i) {
+        sites.push_back({first_processing + static_cast<int>(i / this->num_outputs), MutationSiteType::Output, static_cast<int>(i % this->num_outputs)});
+    });
+
+    // 参照する入力データ: 判定ノードごとに 1 箇所です。
+    sample_sites(randomizer, this->data_source_mutation_rate, num_judgement_nodes, [&](long long i) {
+        sites.push_back({first_judgement + static_cast<int>(i), MutationSiteType::DataSource, 0});
+    });
+
+    // 分岐関数の内部パラメータ: カテゴリ判定ノードはカテゴリ値ごと、数値判定ノードは 1 箇所です。
+    // (カテゴリ判定ノードが参照する入力属性のカテゴリ値の範囲外の箇所は、ノード側で無視されます。)
+    auto category_sites = this->num_category_judgement_nodes * this->num_categories;
+    sample_sites(randomizer, this->judgement_function_mutation_rate, category_sites + this->num_numeric_judgement_nodes, [&](long long i) {
+        if (i < category_sites)
+            sites.push_back({first_judgement + static_cast<int>(i / this->num_categories), MutationSiteType::JudgementFunction, static_cast<int>(i % this->num_categories)});
+        else
+            sites.push_back({first_numeric_judgement + static_cast<int>(i - category_sites), MutationSiteType::JudgementFunction, 0});
+    });
+
+    std::sort(sites.begin(), sites.end(), [](const MutationSite &a, const MutationSite &b) {
+        return a.gene < b.gene;
+    });
+}
+}
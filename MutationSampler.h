@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+
+#include "GNPConfig.h"
+#include "GNPTypes.h"
+
+namespace gnp
+{
+// 突然変異で変更する内容の種類。
+enum class MutationSiteType
+{
+    Branch,           // 接続先ノード(スロットは分岐のインデックス)。
+    Output,           // 出力値(スロットは出力属性のインデックス)。
+    DataSource,       // 参照する入力データ。
+    JudgementFunction // 分岐関数の内部パラメータ(カテゴリ判定ノードのスロットはカテゴリ値 - 最小値)。
+};
+
+// 突然変異で変更する 1 箇所を表します。
+struct MutationSite
+{
+    int gene;
+    MutationSiteType type;
+    int slot;
+};
+
+// 1 つのノードで突然変異により変更する箇所の集合を表します(領域は参照するだけで保持しません)。
+class MutationSites
+{
+  public:
+    MutationSites(const MutationSite *first, const MutationSite *last) : first(first), last(last) {}
+
+    // すべての箇所を変更する集合を取得します。
+    static MutationSites all()
+    {
+        auto sites = MutationSites(nullptr, nullptr);
+        sites.is_all = true;
+        return sites;
+    }
+
+    // すべての箇所を変更するかどうかを取得します。
+    bool contains_all() const
+    {
+        return this->is_all;
+    }
+
+    // 指定された箇所を変更するかどうかを取得します。
+    bool contains(MutationSiteType type, int slot = 0) const
+    {
+        if (this->is_all)
+            return true;
+        for (auto site = this->first; site != this->last; site++)
+        {
+            if (site->type == type && site->slot == slot)
+                return true;
+        }
+        return false;
+    }
+
+  private:
+    const MutationSite *first;
+    const MutationSite *last;
+    bool is_all = false;
+};
+
+// 個体の突然変異で変更する箇所を、変更の確率に従って抽出します。
+// 箇所を 1 つずつ判定する代わりに、次に変更する箇所までの間隔を幾何分布から求めて読み飛ばすため、
+// 計算量はノード数ではなく変更する箇所の数に比例します。
+class MutationSampler
+{
+  public:
+    MutationSampler(const GNPConfig &config);
+
+    // 変更する箇所をノードのインデックス順に sites に格納します。
+    void sample(randomizer_t &randomizer, std::vector<MutationSite> &sites) const;
+
+  private:
+    int num_category_judgement_nodes;
+    int num_numeric_judgement_nodes;
+    int num_processing_nodes;
+    int num_branches;
+    int num_outputs;
+
+    // カテゴリ判定ノード 1 つあたりの分岐関数のパラメータの箇所数(カテゴリ値の範囲が最も広い入力属性に合わせます)。
+    long long num_categories;
+
+    double branch_mutation_rate;
+    double output_mutation_rate;
+    double data_source_mutation_rate;
+    double judgement_function_mutation_rate;
+};
+}
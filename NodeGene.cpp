@@ -1,9 +1,11 @@
 #include <sstream>
 
-#include "Genome.h"
+#include "GenePool.h"
 #include "NodeGene.h"
+#include "ThresholdSearch.h"
 #include "assert.h"
 #include "format.h"
+#include "hash.h"
 #include "runtime_assert.h"
 
 namespace gnp
@@ -33,80 +35,105 @@ static inline int dice(randomizer_t &randomizer, int max)
     return std::uniform_int_distribution<int>(0, max - 1)(randomizer);
 }
 
-static inline int dice(randomizer_t &randomizer, const std::vector<double> &probabilities)
+// 接続先ノードを一様に選びます(遷移開始ノードと、index のノード自身は除きます)。
+static inline int dice_target(randomizer_t &randomizer, int num_genes, int index)
 {
-    assert(0 < std::accumulate(probabilities.begin(), probabilities.end(), 0.0), "All probabilities is 0.");
-    return std::discrete_distribution<int>(probabilities.begin(), probabilities.end())(randomizer);
+    // 候補 1, 2, ..., num_genes - 1 から index を除いた番号を、除いた分を詰めた連番から引きます。
+    auto num_candidates = index == 0 ? num_genes - 1 : num_genes - 2;
+    assert(0 < num_candidates, "No target candidates.");
+    auto target = 1 + dice(randomizer, num_candidates);
+    if (index != 0 && index <= target)
+        target++;
+    return target;
 }
 
-const AbstractNodeGene *InitialNodeGene::next(const Vector<data_t> &values) const
+// 指定された種類の入力属性のインデックスを一様に選びます。
+static inline int dice_attribute(randomizer_t &randomizer, const std::vector<DataAttribute> &attributes, DataAttributeType type)
 {
-    assert(this->target < this->owner->genes.size(), "Index is out of range.");
-    return this->owner->genes[this->target].get();
+    auto count = std::count_if(attributes.begin(), attributes.end(), [type](auto &attribute) { return attribute.type == type; });
+    assert(0 < count, "No attributes of the type.");
+    auto k = dice(randomizer, static_cast<int>(count));
+    for (int i = 0; i < attributes.size(); i++)
+    {
+        if (attributes[i].type == type && k-- == 0)
+            return i;
+    }
+    return -1;
 }
 
-const AbstractNodeGene *ProcessingNodeGene::next(const Vector<data_t> &values) const
+int InitialNodeGene::next(const data_t *values) const
 {
-    assert(this->target < this->owner->genes.size(), "Index is out of range.");
-    return this->owner->genes[this->target].get();
+    return this->target;
 }
 
-const AbstractNodeGene *CategoryJudgementNodeGene::next(const Vector<data_t> &values) const
+int ProcessingNodeGene::next(const data_t *values) const
+{
+    return this->target;
+}
+
+int CategoryJudgementNodeGene::next(const data_t *values) const
 {
     auto data = values[this->source];
     auto value = data.category;
     auto index = this->branches.at(value);
     assert(index < this->targets.size(), "Index is out of range.");
-    assert(this->targets[index] < this->owner->genes.size(), "Index is out of range.");
-    return this->owner->genes[this->targets[index]].get();
+    return this->targets[index];
 }
 
-const AbstractNodeGene *NumericJudgementNodeGene::next(const Vector<data_t> &values) const
+int NumericJudgementNodeGene::next(const data_t *values) const
 {
     auto data = values[this->source];
     auto value = data.numeric;
-    auto index = 0;
-    for (index = 0; index < this->thresholds.size(); index++)
-    {
-        if (value < this->thresholds[index])
-            break;
-    }
+    auto index = search_branch(this->thresholds.data(), this->thresholds.size(), value);
     assert(index < this->targets.size(), "Index is out of range.");
-    return this->owner->genes[this->targets[index]].get();
+    return this->targets[index];
+}
+
+void GeneWriter::clone_source()
+{
+    this->clone = this->source->duplicate(this->pool);
+    this->target = this->clone.get();
+}
+
+std::shared_ptr<AbstractNodeGene> AbstractNodeGene::mutate(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GenePool *pool) const
+{
+    auto writer = GeneWriter(*this, pool);
+    this->apply_mutation(randomizer, config, sites, writer);
+    if (!writer.changed)
+        return nullptr;
+    writer.clone->update_hash();
+    return std::move(writer.clone);
+}
+
+void AbstractNodeGene::randomize(randomizer_t &randomizer, const GNPConfig &config)
+{
+    auto writer = GeneWriter(*this);
+    this->apply_mutation(randomizer, config, MutationSites::all(), writer);
+    this->update_hash();
 }
 
-void InitialNodeGene::mutate(randomizer_t &randomizer, const GNPConfig &config, bool force_mutation)
+void InitialNodeGene::apply_mutation(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GeneWriter &writer) const
 {
     // ランダムに接続先ノードを設定する。
-    if (force_mutation || dice(randomizer) < config.branch_mutation_rate)
-    {
-        auto num_genes = this->owner->genes.size();
-        auto probabilities = std::vector<double>(num_genes, 1.0);
-        probabilities[0] = 0.0;           // Forbid connection to initial node.
-        probabilities[this->index] = 0.0; // Forbid self loop.
-        this->target = dice(randomizer, probabilities);
-    }
+    if (sites.contains(MutationSiteType::Branch))
+        writer.write<InitialNodeGene>().target = dice_target(randomizer, config.num_genes(), this->index);
 }
 
-void ProcessingNodeGene::mutate(randomizer_t &randomizer, const GNPConfig &config, bool force_mutation)
+void ProcessingNodeGene::apply_mutation(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GeneWriter &writer) const
 {
     // ランダムに接続先ノードを設定する。
-    if (force_mutation || dice(randomizer) < config.branch_mutation_rate)
-    {
-        auto num_genes = this->owner->genes.size();
-        auto probabilities = std::vector<double>(num_genes, 1.0);
-        probabilities[0] = 0.0;           // Forbid connection to initial node.
-        probabilities[this->index] = 0.0; // Forbid self loop.
-        this->target = dice(randomizer, probabilities);
-    }
+    if (sites.contains(MutationSiteType::Branch))
+        writer.write<ProcessingNodeGene>().target = dice_target(randomizer, config.num_genes(), this->index);
 
     // ランダムに出力値を設定する。
     auto num_outputs = config.output_attributes.size();
-    this->value.conservativeResize(num_outputs);
+    if (writer.read<ProcessingNodeGene>().value.size() != num_outputs)
+        writer.write<ProcessingNodeGene>().value.conservativeResize(num_outputs);
     for (int i = 0; i < num_outputs; i++)
     {
-        if (force_mutation || dice(randomizer) < config.output_mutation_rate)
+        if (sites.contains(MutationSiteType::Output, i))
         {
+            auto &value = writer.write<ProcessingNodeGene>().value;
             auto &attribute = config.output_attributes[i];
             switch (attribute.type)
             {
@@ -114,14 +141,14 @@ void ProcessingNodeGene::mutate(randomizer_t &randomizer, const GNPConfig &confi
             {
                 auto min = attribute.min.category;
                 auto max = attribute.max.category;
-                this->value[i].category = dice<category_t>(randomizer, min, max);
+                value[i].category = dice<category_t>(randomizer, min, max);
                 break;
             }
             case DataAttributeType::Numeric:
             {
                 auto min = attribute.min.numeric;
                 auto max = attribute.max.numeric;
-                this->value[i].numeric = dice<numeric_t>(randomizer, min, max);
+                value[i].numeric = dice<numeric_t>(randomizer, min, max);
                 break;
             }
             default:
@@ -132,117 +159,106 @@ void ProcessingNodeGene::mutate(randomizer_t &randomizer, const GNPConfig &confi
     }
 }
 
-void AbstractJudgementNodeGene::mutate(randomizer_t &randomizer, const GNPConfig &config, bool force_mutation)
+void AbstractJudgementNodeGene::apply_mutation(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GeneWriter &writer) const
 {
     // ランダムに接続先ノードを設定する。
-    this->targets.resize(config.num_branches);
-    for (auto &target : this->targets)
+    if (writer.read<AbstractJudgementNodeGene>().targets.size() != config.num_branches)
+        writer.write<AbstractJudgementNodeGene>().targets.resize(config.num_branches);
+    for (int i = 0; i < config.num_branches; i++)
     {
-        if (force_mutation || dice(randomizer) < config.branch_mutation_rate)
+        if (sites.contains(MutationSiteType::Branch, i))
         {
-            auto num_genes = this->owner->genes.size();
-            auto probabilities = std::vector<double>(num_genes, 1.0);
-            probabilities[0] = 0.0;           // Forbid connection to initial node.
-            probabilities[this->index] = 0.0; // Forbid connection of self loop.
-            target = dice(randomizer, probabilities);
+            auto target = dice_target(randomizer, config.num_genes(), this->index);
+            writer.write<AbstractJudgementNodeGene>().targets[i] = target;
         }
     }
 }
 
-void CategoryJudgementNodeGene::mutate(randomizer_t &randomizer, const GNPConfig &config, bool force_mutation)
+void CategoryJudgementNodeGene::apply_mutation(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GeneWriter &writer) const
 {
-    base::mutate(randomizer, config, force_mutation);
+    base::apply_mutation(randomizer, config, sites, writer);
 
     // ランダムに参照する入力データのインデックスを設定する。
     bool reference_is_changed = false;
-    if (force_mutation || dice(randomizer) < config.data_source_mutation_rate)
+    if (sites.contains(MutationSiteType::DataSource))
     {
-        auto num_inputs = config.input_attributes.size();
-        auto probabilities = std::vector<double>(num_inputs, 0.0);
-        for (int i = 0; i < num_inputs; i++)
-            if (config.input_attributes[i].type == DataAttributeType::Category)
-                probabilities[i] = 1.0;
-        this->source = dice(randomizer, probabilities);
+        writer.write<CategoryJudgementNodeGene>().source = dice_attribute(randomizer, config.input_attributes, DataAttributeType::Category);
 
         reference_is_changed = true;
     }
 
     // ランダムに分岐関数の内部パラメータを設定する。
-    auto &attribute = config.input_attributes[this->source];
+    auto &attribute = config.input_attributes[writer.read<CategoryJudgementNodeGene>().source];
     auto min = attribute.min.category;
     auto max = attribute.max.category;
-    if (force_mutation || reference_is_changed)
-        this->branches.clear();
+    if (sites.contains_all() || reference_is_changed)
+        writer.write<CategoryJudgementNodeGene>().branches.clear();
     for (auto category = min; category <= max; category++)
     {
-        if (force_mutation || reference_is_changed || dice(randomizer) < config.judgement_function_mutation_rate)
+        if (reference_is_changed || sites.contains(MutationSiteType::JudgementFunction, static_cast<int>(category - min)))
         {
             auto index = dice(randomizer, config.num_branches);
-            this->branches[category] = index;
+            writer.write<CategoryJudgementNodeGene>().branches.set(category, index);
         }
     }
 }
 
-void NumericJudgementNodeGene::mutate(randomizer_t &randomizer, const GNPConfig &config, bool force_mutation)
+void NumericJudgementNodeGene::apply_mutation(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GeneWriter &writer) const
 {
-    base::mutate(randomizer, config, force_mutation);
+    base::apply_mutation(randomizer, config, sites, writer);
 
     // ランダムに参照する入力データのインデックスを設定する。
     bool reference_is_changed = false;
-    if (force_mutation || dice(randomizer) < config.data_source_mutation_rate)
+    if (sites.contains(MutationSiteType::DataSource))
     {
-        auto num_inputs = config.input_attributes.size();
-        auto probabilities = std::vector<double>(num_inputs, 0.0);
-        for (int i = 0; i < num_inputs; i++)
-            if (config.input_attributes[i].type == DataAttributeType::Numeric)
-                probabilities[i] = 1.0;
-        this->source = dice(randomizer, probabilities);
+        writer.write<NumericJudgementNodeGene>().source = dice_attribute(randomizer, config.input_attributes, DataAttributeType::Numeric);
 
         reference_is_changed = true;
     }
 
     // ランダムに分岐関数の内部パラメータを設定する。
-    if (force_mutation || reference_is_changed || dice(randomizer) < config.judgement_function_mutation_rate)
+    if (sites.contains(MutationSiteType::JudgementFunction) || reference_is_changed)
     {
-        this->thresholds.resize(config.num_branches - 1); // 注; しきい値の個数は分岐数 - 1
-        auto &attribute = config.input_attributes[this->source];
+        auto &node = writer.write<NumericJudgementNodeGene>();
+        node.thresholds.resize(config.num_branches - 1); // 注; しきい値の個数は分岐数 - 1
+        auto &attribute = config.input_attributes[node.source];
         auto min = attribute.min.numeric;
         auto max = attribute.max.numeric;
-        for (int i = 0; i < this->thresholds.size(); i++)
+        for (int i = 0; i < node.thresholds.size(); i++)
         {
             auto threshold = dice<numeric_t>(randomizer, min, max);
-            this->thresholds[i] = threshold;
+            node.thresholds[i] = threshold;
         }
+        std::sort(node.thresholds.begin(), node.thresholds.end());
     }
-    std::sort(this->thresholds.begin(), this->thresholds.end());
 }
 
-std::unique_ptr<AbstractNodeGene> InitialNodeGene::duplicate(const Genome *owner) const
+template <typename T>
+static std::shared_ptr<AbstractNodeGene> duplicate_gene(const T &source, GenePool *pool)
+{
+    if (pool)
+        return pool->duplicate(source);
+    return std::make_shared<T>(source);
+}
+
+std::shared_ptr<AbstractNodeGene> InitialNodeGene::duplicate(GenePool *pool) const
 {
-    auto ptr = std::unique_ptr<AbstractNodeGene>(new InitialNodeGene(*this));
-    ptr->owner = owner;
-    return ptr;
+    return duplicate_gene(*this, pool);
 }
 
-std::unique_ptr<AbstractNodeGene> ProcessingNodeGene::duplicate(const Genome *owner) const
+std::shared_ptr<AbstractNodeGene> ProcessingNodeGene::duplicate(GenePool *pool) const
 {
-    auto ptr = std::unique_ptr<AbstractNodeGene>(new ProcessingNodeGene(*this));
-    ptr->owner = owner;
-    return ptr;
+    return duplicate_gene(*this, pool);
 }
 
-std::unique_ptr<AbstractNodeGene> CategoryJudgementNodeGene::duplicate(const Genome *owner) const
+std::shared_ptr<AbstractNodeGene> CategoryJudgementNodeGene::duplicate(GenePool *pool) const
 {
-    auto ptr = std::unique_ptr<AbstractNodeGene>(new CategoryJudgementNodeGene(*this));
-    ptr->owner = owner;
-    return ptr;
+    return duplicate_gene(*this, pool);
 }
 
-std::unique_ptr<AbstractNodeGene> NumericJudgementNodeGene::duplicate(const Genome *owner) const
+std::shared_ptr<AbstractNodeGene> NumericJudgementNodeGene::duplicate(GenePool *pool) const
 {
-    auto ptr = std::unique_ptr<AbstractNodeGene>(new NumericJudgementNodeGene(*this));
-    ptr->owner = owner;
-    return ptr;
+    return duplicate_gene(*this, pool);
 }
 
 void AbstractNodeGene::serialize(picojson::object &object, const GNPConfig &config) const
@@ -255,9 +271,12 @@ void AbstractNodeGene::serialize(picojson::object &object, const GNPConfig &conf
 void AbstractNodeGene::deserialize(const picojson::object &object, const GNPConfig &config)
 {
     runtime_assert(object.at("typeid").get<std::string>() == typeid(*this).name());
-    this->owner = nullptr;
     this->index = static_cast<int>(object.at("index").get<double>());
-    this->delay = static_cast<double>(object.at("delay").get<double>());
+
+    // 出力の領域は設定のノードの実行時間から確保するため、設定と異なる実行時間のノードは受け付けません。
+    // (this の実行時間は、設定から作成した時点の値です。)
+    auto delay = static_cast<double>(object.at("delay").get<double>());
+    runtime_assert(delay == this->delay, "Node delay does not match the config.");
 }
 
 void InitialNodeGene::serialize(picojson::object &object, const GNPConfig &config) const
@@ -351,8 +370,9 @@ void CategoryJudgementNodeGene::serialize(picojson::object &object, const GNPCon
 {
     base::serialize(object, config);
 
-    picojson::array branches(this->branches.size());
-    std::transform(this->branches.begin(), this->branches.end(), branches.begin(), [](auto pair) {
+    auto items = this->branches.items();
+    picojson::array branches(items.size());
+    std::transform(items.begin(), items.end(), branches.begin(), [](auto pair) {
         picojson::object obj;
         obj["first"] = picojson::value(static_cast<double>(pair.first));
         obj["second"] = picojson::value(static_cast<double>(pair.second));
@@ -371,7 +391,7 @@ void CategoryJudgementNodeGene::deserialize(const picojson::object &object, cons
     {
         auto first = static_cast<category_t>(obj.get<picojson::object>().at("first").get<double>());
         auto second = static_cast<int>(obj.get<picojson::object>().at("second").get<double>());
-        this->branches[first] = second;
+        this->branches.set(first, second);
     }
 }
 
@@ -395,6 +415,113 @@ void NumericJudgementNodeGene::deserialize(const picojson::object &object, const
     std::transform(thresholds.begin(), thresholds.end(), this->thresholds.begin(), [](auto &threshold) {
         return static_cast<numeric_t>(threshold.template get<double>());
     });
+    std::sort(this->thresholds.begin(), this->thresholds.end()); // 注; ブランチの探索はしきい値が昇順であることを前提とする
+}
+
+void AbstractNodeGene::encode(BinaryWriter &writer, const GNPConfig &config) const
+{
+}
+
+void AbstractNodeGene::decode(BinaryReader &reader, const GNPConfig &config)
+{
+}
+
+void InitialNodeGene::encode(BinaryWriter &writer, const GNPConfig &config) const
+{
+    base::encode(writer, config);
+
+    writer.write<std::int32_t>(this->target);
+}
+
+void InitialNodeGene::decode(BinaryReader &reader, const GNPConfig &config)
+{
+    base::decode(reader, config);
+
+    this->target = reader.read<std::int32_t>();
+}
+
+void ProcessingNodeGene::encode(BinaryWriter &writer, const GNPConfig &config) const
+{
+    base::encode(writer, config);
+
+    writer.write<std::int32_t>(this->target);
+    for (int i = 0; i < this->value.size(); i++)
+        writer.write(this->value[i]);
+}
+
+void ProcessingNodeGene::decode(BinaryReader &reader, const GNPConfig &config)
+{
+    base::decode(reader, config);
+
+    this->target = reader.read<std::int32_t>();
+    this->value.resize(config.output_attributes.size());
+    for (int i = 0; i < this->value.size(); i++)
+        this->value[i] = reader.read<data_t>();
+}
+
+void AbstractJudgementNodeGene::encode(BinaryWriter &writer, const GNPConfig &config) const
+{
+    base::encode(writer, config);
+
+    writer.write<std::int32_t>(this->targets.size());
+    for (auto target : this->targets)
+        writer.write<std::int32_t>(target);
+    writer.write<std::int32_t>(this->source);
+}
+
+void AbstractJudgementNodeGene::decode(BinaryReader &reader, const GNPConfig &config)
+{
+    base::decode(reader, config);
+
+    this->targets.resize(reader.read<std::int32_t>());
+    for (auto &target : this->targets)
+        target = reader.read<std::int32_t>();
+    this->source = reader.read<std::int32_t>();
+}
+
+void CategoryJudgementNodeGene::encode(BinaryWriter &writer, const GNPConfig &config) const
+{
+    base::encode(writer, config);
+
+    auto items = this->branches.items();
+    writer.write<std::int32_t>(items.size());
+    for (auto &pair : items)
+    {
+        writer.write(pair.first);
+        writer.write<std::int32_t>(pair.second);
+    }
+}
+
+void CategoryJudgementNodeGene::decode(BinaryReader &reader, const GNPConfig &config)
+{
+    base::decode(reader, config);
+
+    auto count = reader.read<std::int32_t>();
+    this->branches.clear();
+    for (int i = 0; i < count; i++)
+    {
+        auto first = reader.read<category_t>();
+        auto second = reader.read<std::int32_t>();
+        this->branches.set(first, second);
+    }
+}
+
+void NumericJudgementNodeGene::encode(BinaryWriter &writer, const GNPConfig &config) const
+{
+    base::encode(writer, config);
+
+    writer.write<std::int32_t>(this->thresholds.size());
+    for (auto threshold : this->thresholds)
+        writer.write(threshold);
+}
+
+void NumericJudgementNodeGene::decode(BinaryReader &reader, const GNPConfig &config)
+{
+    base::decode(reader, config);
+
+    this->thresholds.resize(reader.read<std::int32_t>());
+    for (auto &threshold : this->thresholds)
+        threshold = reader.read<numeric_t>();
 }
 
 bool AbstractNodeGene::equal_to(const AbstractNodeGene *other) const
@@ -436,4 +563,52 @@ bool AbstractNodeGene::not_equal_to(const AbstractNodeGene *other) const
 {
     return !this->equal_to(other);
 }
+
+std::uint64_t AbstractNodeGene::compute_hash() const
+{
+    auto hash = hash_combine(0, this->index);
+    return hash_combine(hash, hash_floating(this->delay));
+}
+
+std::uint64_t InitialNodeGene::compute_hash() const
+{
+    auto hash = hash_combine(base::compute_hash(), 1); // (ノードの種類)
+    return hash_combine(hash, this->target);
+}
+
+std::uint64_t ProcessingNodeGene::compute_hash() const
+{
+    auto hash = hash_combine(base::compute_hash(), 2); // (ノードの種類)
+    hash = hash_combine(hash, this->target);
+    for (int i = 0; i < this->value.size(); i++)
+        hash = hash_combine(hash, hash_bits(this->value[i].category));
+    return hash;
+}
+
+std::uint64_t AbstractJudgementNodeGene::compute_hash() const
+{
+    auto hash = hash_combine(base::compute_hash(), this->source);
+    for (auto target : this->targets)
+        hash = hash_combine(hash, target);
+    return hash;
+}
+
+std::uint64_t CategoryJudgementNodeGene::compute_hash() const
+{
+    auto hash = hash_combine(base::compute_hash(), 3); // (ノードの種類)
+    for (auto &pair : this->branches.items())
+    {
+        hash = hash_combine(hash, hash_bits(pair.first));
+        hash = hash_combine(hash, pair.second);
+    }
+    return hash;
+}
+
+std::uint64_t NumericJudgementNodeGene::compute_hash() const
+{
+    auto hash = hash_combine(base::compute_hash(), 4); // (ノードの種類)
+    for (auto threshold : this->thresholds)
+        hash = hash_combine(hash, hash_floating(threshold));
+    return hash;
+}
 }
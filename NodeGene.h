@@ -1,49 +1,124 @@
 #pragma once
 
-#include <map>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
 #include <picojson.h>
 
+#include "BinaryStream.h"
+#include "CategoryBranchTable.h"
 #include "GNPConfig.h"
 #include "GNPTypes.h"
+#include "MutationSampler.h"
 
 namespace gnp
 {
-class Genome;
+class AbstractNodeGene;
+class GenePool;
+
+// 突然変異で内容を書き込むノードです。
+// 元のノードは変更せず、最初に書き込むときに複製を作成します(直接書き込む場合を除きます)。
+class GeneWriter
+{
+  public:
+    // source に最初に書き込むときに複製を作成します(pool を指定した場合は、プールのノードを再利用します)。
+    GeneWriter(const AbstractNodeGene &source, GenePool *pool) : source(&source), pool(pool) {}
+
+    // target に直接書き込みます。
+    explicit GeneWriter(AbstractNodeGene &target) : source(&target), target(&target) {}
+
+    // 書き込み済みの内容を含む、現在の内容を取得します。
+    template <typename T>
+    const T &read() const
+    {
+        const AbstractNodeGene *gene = this->target ? this->target : this->source;
+        return static_cast<const T &>(*gene);
+    }
+
+    // 内容を書き込むノードを取得します(初回は元のノードの複製を作成します)。
+    template <typename T>
+    T &write()
+    {
+        if (!this->target)
+            this->clone_source();
+        this->changed = true;
+        return static_cast<T &>(*this->target);
+    }
+
+  public:
+    // 作成した複製(直接書き込む場合と、書き込まなかった場合は nullptr)。
+    std::shared_ptr<AbstractNodeGene> clone;
+
+    // いずれかの内容を書き込んだかどうか。
+    bool changed = false;
+
+  private:
+    void clone_source();
+
+    const AbstractNodeGene *source;
+
+    AbstractNodeGene *target = nullptr;
+
+    GenePool *pool = nullptr;
+};
 
 // 何らかのノードを表します。
+// 個体間で共有されるため、個体に格納した後は内容を変更しません(突然変異では変更後の複製を作成します)。
 class AbstractNodeGene
 {
   public:
     virtual ~AbstractNodeGene() {}
 
-    AbstractNodeGene(const Genome *owner, int index, double delay) : owner(owner), index(index), delay(delay) {}
+    AbstractNodeGene(int index, double delay) : index(index), delay(delay) {}
 
-    virtual const AbstractNodeGene *next(const Vector<data_t> &record) const = 0;
+    // 次に実行するノードのインデックスを取得します。
+    virtual int next(const data_t *record) const = 0;
 
-    virtual void mutate(randomizer_t &randomizer, const GNPConfig &config, bool force_mutation = false) = 0;
+    // sites の箇所に突然変異を行います。内容を変更した場合は変更後の複製を返し、変更しなかった場合は nullptr を返します(このノードは変更しません)。
+    // pool を指定した場合は、複製にプールのノードを再利用します。
+    std::shared_ptr<AbstractNodeGene> mutate(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GenePool *pool = nullptr) const;
 
-    virtual std::unique_ptr<AbstractNodeGene> duplicate(const Genome *owner) const = 0;
+    // すべての内容をランダムに設定します(新しい個体の生成で使用します)。
+    void randomize(randomizer_t &randomizer, const GNPConfig &config);
+
+    // ノードを複製します(pool を指定した場合は、プールのノードを再利用します)。
+    virtual std::shared_ptr<AbstractNodeGene> duplicate(GenePool *pool = nullptr) const = 0;
 
     virtual void serialize(picojson::object &object, const GNPConfig &config) const;
 
     virtual void deserialize(const picojson::object &object, const GNPConfig &config);
 
+    // ノードの内容をバイト列に書き込みます(インデックスと実行時間は設定から決まるため、書き込みません)。
+    virtual void encode(BinaryWriter &writer, const GNPConfig &config) const;
+
+    virtual void decode(BinaryReader &reader, const GNPConfig &config);
+
     virtual bool equal_to(const AbstractNodeGene *other) const;
 
     virtual bool not_equal_to(const AbstractNodeGene *other) const;
 
-  public:
-    // このノードを所有している Genome インスタンス。
-    const Genome *owner = nullptr;
+    // ハッシュ値をノードの内容から再計算します。
+    void update_hash()
+    {
+        this->hash = this->compute_hash();
+    }
+
+  protected:
+    virtual std::uint64_t compute_hash() const;
+
+    // sites の箇所に突然変異を行い、変更する内容を writer に書き込みます。
+    virtual void apply_mutation(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GeneWriter &writer) const = 0;
 
+  public:
     // このノードが格納される配列におけるこのノードのインデックス。
     int index = 0;
 
     // このノードの実行に要する時間。
     double delay = 0.0;
+
+    // ノードの内容(インデックスを含む)から求めたハッシュ値。内容を変更した場合は update_hash で更新します。
+    std::uint64_t hash = 0;
 };
 
 // 遷移開始ノードを表します。
@@ -52,20 +127,27 @@ class InitialNodeGene : public AbstractNodeGene
     using base = AbstractNodeGene;
 
   public:
-    InitialNodeGene(const Genome *owner, int index, const GNPConfig &config) : base(owner, index, 0.0) {}
-
-    const AbstractNodeGene *next(const Vector<data_t> &record) const override;
+    InitialNodeGene(int index, const GNPConfig &config) : base(index, 0.0) {}
 
-    void mutate(randomizer_t &randomizer, const GNPConfig &config, bool force_mutation = false) override;
+    int next(const data_t *record) const override;
 
-    std::unique_ptr<AbstractNodeGene> duplicate(const Genome *owner) const override;
+    std::shared_ptr<AbstractNodeGene> duplicate(GenePool *pool = nullptr) const override;
 
     void serialize(picojson::object &object, const GNPConfig &config) const override;
 
     void deserialize(const picojson::object &object, const GNPConfig &config) override;
 
+    void encode(BinaryWriter &writer, const GNPConfig &config) const override;
+
+    void decode(BinaryReader &reader, const GNPConfig &config) override;
+
     bool equal_to(const AbstractNodeGene *other) const override;
 
+  protected:
+    std::uint64_t compute_hash() const override;
+
+    void apply_mutation(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GeneWriter &writer) const override;
+
   public:
     // このノードの接続先ノードのインデックス。
     int target;
@@ -77,20 +159,27 @@ class ProcessingNodeGene : public AbstractNodeGene
     using base = AbstractNodeGene;
 
   public:
-    ProcessingNodeGene(const Genome *owner, int index, const GNPConfig &config) : base(owner, index, config.delay_time_processing_node) {}
-
-    const AbstractNodeGene *next(const Vector<data_t> &record) const override;
+    ProcessingNodeGene(int index, const GNPConfig &config) : base(index, config.delay_time_processing_node) {}
 
-    void mutate(randomizer_t &randomizer, const GNPConfig &config, bool force_mutation = false) override;
+    int next(const data_t *record) const override;
 
-    std::unique_ptr<AbstractNodeGene> duplicate(const Genome *owner) const override;
+    std::shared_ptr<AbstractNodeGene> duplicate(GenePool *pool = nullptr) const override;
 
     void serialize(picojson::object &object, const GNPConfig &config) const override;
 
     void deserialize(const picojson::object &object, const GNPConfig &config) override;
 
+    void encode(BinaryWriter &writer, const GNPConfig &config) const override;
+
+    void decode(BinaryReader &reader, const GNPConfig &config) override;
+
     bool equal_to(const AbstractNodeGene *other) const override;
 
+  protected:
+    std::uint64_t compute_hash() const override;
+
+    void apply_mutation(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GeneWriter &writer) const override;
+
   public:
     // このノードの接続先ノードのインデックス。
     int target;
@@ -105,16 +194,23 @@ class AbstractJudgementNodeGene : public AbstractNodeGene
     using base = AbstractNodeGene;
 
   public:
-    AbstractJudgementNodeGene(const Genome *owner, int index, double delay) : base(owner, index, delay) {}
-
-    void mutate(randomizer_t &randomizer, const GNPConfig &config, bool force_mutation = false) override;
+    AbstractJudgementNodeGene(int index, double delay) : base(index, delay) {}
 
     void serialize(picojson::object &object, const GNPConfig &config) const override;
 
     void deserialize(const picojson::object &object, const GNPConfig &config) override;
 
+    void encode(BinaryWriter &writer, const GNPConfig &config) const override;
+
+    void decode(BinaryReader &reader, const GNPConfig &config) override;
+
     bool equal_to(const AbstractNodeGene *other) const override;
 
+  protected:
+    std::uint64_t compute_hash() const override;
+
+    void apply_mutation(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GeneWriter &writer) const override;
+
   public:
     // このノードの接続先ノードのインデックス。
     std::vector<int> targets;
@@ -129,23 +225,30 @@ class CategoryJudgementNodeGene : public AbstractJudgementNodeGene
     using base = AbstractJudgementNodeGene;
 
   public:
-    CategoryJudgementNodeGene(const Genome *owner, int index, const GNPConfig &config) : base(owner, index, config.delay_time_judgement_node) {}
-
-    const AbstractNodeGene *next(const Vector<data_t> &record) const override;
+    CategoryJudgementNodeGene(int index, const GNPConfig &config) : base(index, config.delay_time_judgement_node) {}
 
-    void mutate(randomizer_t &randomizer, const GNPConfig &config, bool force_mutation = false) override;
+    int next(const data_t *record) const override;
 
-    std::unique_ptr<AbstractNodeGene> duplicate(const Genome *owner) const override;
+    std::shared_ptr<AbstractNodeGene> duplicate(GenePool *pool = nullptr) const override;
 
     void serialize(picojson::object &object, const GNPConfig &config) const override;
 
     void deserialize(const picojson::object &object, const GNPConfig &config) override;
 
+    void encode(BinaryWriter &writer, const GNPConfig &config) const override;
+
+    void decode(BinaryReader &reader, const GNPConfig &config) override;
+
     bool equal_to(const AbstractNodeGene *other) const override;
 
+  protected:
+    std::uint64_t compute_hash() const override;
+
+    void apply_mutation(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GeneWriter &writer) const override;
+
   public:
     // カテゴリからブランチのインデックスへの変換関数。
-    std::map<category_t, int> branches;
+    CategoryBranchTable branches;
 };
 
 // 数値属性の判定ノードを表します。
@@ -154,20 +257,27 @@ class NumericJudgementNodeGene : public AbstractJudgementNodeGene
     using base = AbstractJudgementNodeGene;
 
   public:
-    NumericJudgementNodeGene(const Genome *owner, int index, const GNPConfig &config) : base(owner, index, config.delay_time_judgement_node) {}
+    NumericJudgementNodeGene(int index, const GNPConfig &config) : base(index, config.delay_time_judgement_node) {}
 
-    const AbstractNodeGene *next(const Vector<data_t> &record) const override;
+    int next(const data_t *record) const override;
 
-    void mutate(randomizer_t &randomizer, const GNPConfig &config, bool force_mutation = false) override;
-
-    std::unique_ptr<AbstractNodeGene> duplicate(const Genome *owner) const override;
+    std::shared_ptr<AbstractNodeGene> duplicate(GenePool *pool = nullptr) const override;
 
     void serialize(picojson::object &object, const GNPConfig &config) const override;
 
     void deserialize(const picojson::object &object, const GNPConfig &config) override;
 
+    void encode(BinaryWriter &writer, const GNPConfig &config) const override;
+
+    void decode(BinaryReader &reader, const GNPConfig &config) override;
+
     bool equal_to(const AbstractNodeGene *other) const override;
 
+  protected:
+    std::uint64_t compute_hash() const override;
+
+    void apply_mutation(randomizer_t &randomizer, const GNPConfig &config, const MutationSites &sites, GeneWriter &writer) const override;
+
   public:
     // 数値データの値を分割するしきい値。
     std::vector<numeric_t> thresholds;
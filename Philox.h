@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+
+namespace gnp
+{
+// カウンタベースの疑似乱数生成器 Philox4x32-10 です(Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC'11)。
+// 乱数はシード(鍵)と (stream, substream, ブロック番号) のカウンタだけから決まるため、
+// 系列ごとに生成器を作成すれば、スレッドの数や処理の順序によらず同じ乱数列が得られます。
+// UniformRandomBitGenerator の要件を満たし、標準ライブラリの分布クラスと組み合わせて使用できます。
+class Philox
+{
+  public:
+    typedef std::uint64_t result_type;
+
+    // seed を鍵として、(stream, substream) で指定される系列の先頭から生成します。
+    explicit Philox(std::uint64_t seed = 5489u, std::uint64_t stream = 0, std::uint32_t substream = 0)
+    {
+        this->key[0] = static_cast<std::uint32_t>(seed);
+        this->key[1] = static_cast<std::uint32_t>(seed >> 32);
+        this->counter[0] = 0;
+        this->counter[1] = substream;
+        this->counter[2] = static_cast<std::uint32_t>(stream);
+        this->counter[3] = static_cast<std::uint32_t>(stream >> 32);
+    }
+
+    static constexpr result_type min()
+    {
+        return 0;
+    }
+
+    static constexpr result_type max()
+    {
+        return ~static_cast<result_type>(0);
+    }
+
+    result_type operator()()
+    {
+        // (1 ブロックから 64 ビットの乱数を 2 個生成します。)
+        if (this->position == 2)
+        {
+            this->generate();
+            this->position = 0;
+        }
+        auto i = this->position++ * 2;
+        return static_cast<result_type>(this->block[i]) | (static_cast<result_type>(this->block[i + 1]) << 32);
+    }
+
+    void discard(unsigned long long n)
+    {
+        for (; n; n--)
+            (*this)();
+    }
+
+  private:
+    // 現在のカウンタのブロックを暗号化し、ブロック番号を進めます。
+    void generate()
+    {
+        std::uint32_t x[4] = {this->counter[0], this->counter[1], this->counter[2], this->counter[3]};
+        std::uint32_t k[2] = {this->key[0], this->key[1]};
+        for (int round = 0; round < 10; round++)
+        {
+            auto product0 = static_cast<std::uint64_t>(0xD2511F53u) * x[0];
+            auto product1 = static_cast<std::uint64_t>(0xCD9E8D57u) * x[2];
+            auto y0 = static_cast<std::uint32_t>(product1 >> 32) ^ x[1] ^ k[0];
+            auto y1 = static_cast<std::uint32_t>(product1);
+            auto y2 = static_cast<std::uint32_t>(product0 >> 32) ^ x[3] ^ k[1];
+            auto y3 = static_cast<std::uint32_t>(product0);
+            x[0] = y0;
+            x[1] = y1;
+            x[2] = y2;
+            x[3] = y3;
+            k[0] += 0x9E3779B9u;
+            k[1] += 0xBB67AE85u;
+        }
+        for (int i = 0; i < 4; i++)
+            this->block[i] = x[i];
+        this->counter[0]++;
+    }
+
+    std::uint32_t key[2];
+    std::uint32_t counter[4];
+    std::uint32_t block[4] = {};
+
+    // block から次に取り出す乱数の位置(2 の場合は次のブロックを生成します)。
+    int position = 2;
+};
+}
@@ -1,117 +1,722 @@
 #include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <fstream>
+#include <iterator>
+#include <memory>
+#include <numeric>
 #include <random>
 #include <sstream>
+#include <unordered_map>
 
-#include <omp.h>
-
+#include "CompiledGenome.h"
 #include "Population.h"
+#include "ScopedGILRelease.h"
+#include "ThreadPool.h"
+#include "hash.h"
 #include "runtime_assert.h"
 
 namespace gnp
 {
+// シードが指定されていない場合に使用するシードを作成します。
+static std::uint64_t random_seed()
+{
+    std::random_device device;
+    return (static_cast<std::uint64_t>(device()) << 32) | device();
+}
+
+// 全レコードの経路を記録する、空の領域を作成します。
+static std::shared_ptr<ActivationTrace> create_trace(int num_nodes, int num_records)
+{
+    auto trace = std::make_shared<ActivationTrace>();
+    trace->words = (num_records + 63) / 64;
+    trace->visits.assign(static_cast<size_t>(num_nodes) * trace->words, 0);
+    trace->losses.assign(num_records, 0.0);
+    return trace;
+}
+
 Population::Population(const GNPConfig &config)
+    : Population(config, 0 <= config.seed ? static_cast<std::uint64_t>(config.seed) : random_seed())
 {
-#ifndef _OPENMP
-    this->randomizer = randomizer_t(std::random_device()());
-#else
-    omp_set_num_threads(OMP_NUM_THREADS);
-    this->randomizers.resize(OMP_NUM_THREADS);
-    for (auto &randomizer : this->randomizers)
-        randomizer = randomizer_t(std::random_device()());
-#endif
+}
 
+Population::Population(const GNPConfig &config, std::uint64_t seed)
+    : seed(seed)
+{
+    // 乱数は (シード, 世代, 個体のインデックス) ごとの系列から生成するため、結果はスレッドの数によりません。
     this->genomes.clear();
     this->genomes.resize(config.num_genomes);
-#pragma omp parallel for
-    for (int i = 0; i < this->genomes.size(); i++)
-    {
+    this->thread_pool(config)->parallel_for(0, config.num_genomes, [&](int i, int worker) {
         auto &genome = this->genomes[i];
-#ifndef _OPENMP
-        auto &randomizer = this->randomizer;
-#else
-        auto &randomizer = this->randomizers[omp_get_thread_num()];
-#endif
-        genome.configure_new(randomizer, config);
-    }
+        auto randomizer = randomizer_t(this->seed, this->generation, i);
+        genome.configure_new(randomizer, config, &this->pools[worker]);
+    });
+}
+
+std::shared_ptr<ThreadPool> Population::thread_pool(const GNPConfig &config)
+{
+    auto threads = ThreadPool::instance(config.num_threads);
+    this->pools.reserve(threads->size());
+    while (this->pools.size() < threads->size())
+        this->pools.emplace_back();
+    return threads;
 }
 
 void Population::run(const GNPConfig &config)
 {
-    auto parents = std::move(this->genomes);
-    auto offsprings = std::vector<Genome>();
-    offsprings.reserve(config.num_genomes + config.num_elites);
+    // 子個体は前の世代の領域に上書きし、ノードの配列などの領域を再利用する。
+    auto &parents = this->genomes;
+    auto &offsprings = this->spare_genomes;
+    auto num_crossovers = static_cast<int>(config.num_genomes * config.crossover_rate);
+    auto num_mutations = config.num_genomes - num_crossovers;
+    offsprings.resize(config.num_genomes + config.num_elites);
 
-    // 各親個体の選択確率をルーレット選択方式で計算する。
-    auto fitnesses = std::vector<double>(parents.size());
-    std::for_each(parents.begin(), parents.end(), [](auto &genome) {
-        runtime_assert(0.0 <= genome.fitness, "Fitness value is must greater than 0.");
+    // 子個体ごとに (シード, 世代, 子個体のインデックス) の乱数の系列を使用する。
+    auto generation = this->generation + 1;
+
+    // 設定された選択方式で、親個体を選択する表を作成する(選択は各スレッドから同時に行う)。
+    auto &selection = this->selection;
+    selection.prepare(parents, config);
+
+    // 親個体として選択された個体のインデックス(交叉では 2 個ずつ、突然変異では 1 個ずつ)。
+    auto &indices = this->parent_indices;
+    indices.resize(num_crossovers * 2 + num_mutations);
+
+    // 交叉操作を行う。
+    auto threads = this->thread_pool(config);
+    threads->parallel_for(0, num_crossovers, [&](int i, int worker) {
+        auto randomizer = randomizer_t(this->seed, generation, i);
+        auto &pool = this->pools[worker];
+        indices[i * 2] = selection.select(randomizer);
+        indices[i * 2 + 1] = selection.select(randomizer);
+        auto &parent1 = parents[indices[i * 2]];
+        auto &parent2 = parents[indices[i * 2 + 1]];
+        Genome &offspring = offsprings[i];
+        offspring.configure_crossover(randomizer, parent1, parent2, config, &pool);
     });
-    std::transform(parents.begin(), parents.end(), fitnesses.begin(), [](auto &genome) {
-        return genome.fitness;
+
+    // 突然変異操作を行う。
+    threads->parallel_for(0, num_mutations, [&](int i, int worker) {
+        auto randomizer = randomizer_t(this->seed, generation, num_crossovers + i);
+        auto &pool = this->pools[worker];
+        auto &index = indices[num_crossovers * 2 + i];
+        index = selection.select(randomizer);
+        auto &parent = parents[index];
+        Genome &offspring = offsprings[num_crossovers + i];
+        offspring.configure_inheritance(parent, &pool);
+        offspring.mutate(randomizer, config, &pool);
     });
-    runtime_assert(0.0 < std::accumulate(fitnesses.begin(), fitnesses.end(), 0.0), "All fitness values is 0.");
-    auto distribution = std::discrete_distribution<int>(fitnesses.begin(), fitnesses.end());
 
-    // 交叉操作を行う。
+    // 親個体として選択された個体とエリート個体のハッシュ値。
+    auto &selected = this->selected_hashes;
+    selected.clear();
+    std::transform(indices.begin(), indices.end(), std::back_inserter(selected), [&parents](int index) {
+        return parents[index].hash;
+    });
+
+    // エリート個体をコピーする(ノードは共有される。適合度が NaN の個体は最も低いとみなす)。
+    std::nth_element(
+        parents.begin(),
+        parents.begin() + config.num_elites,
+        parents.end(),
+        [](auto &parent1, auto &parent2) { return is_better_fitness(parent1.fitness, parent2.fitness); });
+    for (int i = 0; i < config.num_elites; i++)
+    {
+        offsprings[config.num_genomes + i].configure_inheritance(parents[i], &this->pools.front());
+        selected.push_back(parents[i].hash);
+    }
+
+    // 世代を更新する(親個体の領域は、次の世代の子個体に再利用する)。
+    std::swap(this->genomes, this->spare_genomes);
+    this->generation = generation;
+    this->judgement_cache.clear();
+
+    // 親個体とエリート個体のノード遷移の経路だけを残す。
+    this->trace_cache.retain(selected);
+}
+
+std::uint64_t Population::evaluation_key(const Dataset &dataset, const GNPConfig &config, const Metric &metric)
+{
+    auto key = hash_combine(0, dataset.id);
+    key = hash_combine(key, hash_floating(config.time_limit));
+    key = hash_combine(key, hash_floating(config.delay_time_processing_node));
+    key = hash_combine(key, hash_floating(config.delay_time_judgement_node));
+    key = hash_combine(key, static_cast<std::uint64_t>(metric.type));
+    key = hash_combine(key, static_cast<std::uint64_t>(metric.transform));
+    key = hash_combine(key, hash_floating(metric.scale));
+    key = hash_combine(key, hash_floating(metric.no_output_value));
+    return key;
+}
+
+std::vector<double> Population::evaluate(const Dataset &dataset, const GNPConfig &config, const Metric &metric, ActivationMode mode)
+{
+    dataset.validate(config, true);
+    metric.validate(config.output_attributes);
+    auto &inputs = dataset.inputs;
+    auto &targets = dataset.targets;
+
+    // 評価の設定が前回と同じ場合は、前回評価した個体と内容が同じ個体(ハッシュ値が同じ個体)の評価を省略します。
+    // 内容が同じ個体が複数ある場合も、評価は 1 度だけ行います。
+    // また、同じ設定で評価された親個体の適合度を引き継げる個体も評価を省略します。
+    auto key = evaluation_key(dataset, config, metric);
+    if (this->fitness_cache_key != key)
     {
-        auto num_offsprings = static_cast<int>(config.num_genomes * config.crossover_rate);
-        auto new_offsprings = std::vector<Genome>(num_offsprings);
-#pragma omp parallel for
-        for (int i = 0; i < num_offsprings; i++)
+        this->fitness_cache.clear();
+        this->fitness_cache_key = key;
+    }
+
+    // 実行方式が Auto の場合は、Frontier 方式を選択した個体と親個体の経路を再利用できる個体について、ノード遷移の経路を記録しながら評価します。
+    this->trace_cache.prepare(key);
+    auto tracing = 0 < this->trace_cache.max_bytes && mode == ActivationMode::Auto;
+
+    auto num_genomes = static_cast<int>(this->genomes.size());
+    auto pending = std::vector<int>();
+    auto pending_hashes = std::unordered_map<std::uint64_t, int>();
+    for (int i = 0; i < num_genomes; i++)
+    {
+        auto &genome = this->genomes[i];
+        if (genome.inherits_fitness && genome.evaluation_key == key)
         {
-#ifndef _OPENMP
-            auto &randomizer = this->randomizer;
-#else
-            auto &randomizer = this->randomizers[omp_get_thread_num()];
-#endif
-            auto &parent1 = parents[distribution(randomizer)];
-            auto &parent2 = parents[distribution(randomizer)];
-            Genome &offspring = new_offsprings[i];
-            offspring.configure_crossover(randomizer, parent1, parent2);
+            // (変更されたノードを実行しないので、経路も親個体と同じです。)
+            if (tracing && genome.hash != genome.parent_hash)
+            {
+                if (auto trace = this->trace_cache.get(genome.parent_hash))
+                    this->trace_cache.put(genome.hash, std::move(trace));
+            }
+            this->fitness_inherited++;
+            continue;
         }
-        auto begin = std::make_move_iterator(new_offsprings.begin());
-        auto end = std::make_move_iterator(new_offsprings.end());
-        offsprings.insert(offsprings.end(), begin, end);
+        auto hash = genome.hash;
+        if (this->fitness_cache.count(hash) || pending_hashes.count(hash))
+        {
+            this->fitness_cache_hits++;
+            continue;
+        }
+        this->fitness_cache_misses++;
+        pending_hashes.emplace(hash, static_cast<int>(pending.size()));
+        pending.push_back(i);
     }
 
-    // 突然変異操作を行う。
+    // レコードを一定数ごとに区切り、(個体, 区間) の組を並列に評価します。
+    // (区間の大きさはスレッド数に依らず一定なので、総和の計算順序も一定です。)
+    constexpr int chunk_size = CompiledGenome::chunk_size;
+    static_assert(chunk_size % 64 == 0, "Chunks must be aligned to words of the visit bit sets.");
+    auto num_pending = static_cast<int>(pending.size());
+    auto num_records = static_cast<int>(inputs.rows());
+    auto num_chunks = (num_records + chunk_size - 1) / chunk_size;
+    auto cols = static_cast<int>(config.output_attributes.size());
+    auto stride = static_cast<int>(inputs.cols());
+
+    // 実行方式は個体ごとに選択します。
+    // 親個体の経路を再利用できる個体は、変更されたノードを実行したレコードだけを Frontier 方式で再評価します。
+    // それ以外の個体は select_mode で実行方式を選択し、Frontier 方式の場合だけ経路を記録します。
+    auto compiled_genomes = std::vector<CompiledGenome>(num_pending);
+    auto modes = std::vector<ActivationMode>(num_pending, mode);
+    auto traces = std::vector<std::shared_ptr<ActivationTrace>>(num_pending);
+    auto incremental = std::vector<uint8_t>(num_pending, 0);
+    auto reevaluated = std::vector<std::vector<int>>(num_pending);
+    auto threads = this->thread_pool(config);
+    threads->parallel_for(0, num_pending, [&](int i, int worker) {
+        auto &compiled = compiled_genomes[i];
+        compiled = CompiledGenome(this->genomes[pending[i]], config);
+        if (tracing)
+            incremental[i] = this->prepare_trace(this->genomes[pending[i]], compiled.num_nodes(), num_records, traces[i], reevaluated[i]);
+        if (incremental[i])
+        {
+            modes[i] = ActivationMode::Frontier;
+        }
+        else if (mode == ActivationMode::Auto)
+        {
+            modes[i] = compiled.select_mode(inputs.data(), num_records, stride, config);
+            if (tracing && modes[i] == ActivationMode::Frontier)
+                traces[i] = create_trace(compiled.num_nodes(), num_records);
+        }
+    });
+
+    // 評価する (個体, 区間) の組。差分で評価する個体の区間は、再評価するレコードの一覧の区間です。
+    auto tasks = std::vector<std::pair<int, int>>();
+    for (int i = 0; i < num_pending; i++)
+    {
+        auto size = incremental[i] ? static_cast<int>(reevaluated[i].size()) : num_records;
+        for (int begin = 0; begin < size; begin += chunk_size)
+            tasks.emplace_back(i, begin);
+    }
+
+    // BranchTable 方式の個体は、同じ判定ノードのブランチの表を個体間で共有します。
+    this->judgement_cache.prepare(dataset);
+    auto shared_tables = std::vector<std::vector<JudgementCache::table_t>>(num_pending);
+    auto table_pointers = std::vector<std::vector<const uint8_t *>>(num_pending);
+    threads->parallel_for(0, num_pending, [&](int i, int worker) {
+        auto &genome = compiled_genomes[i];
+        if (modes[i] != ActivationMode::BranchTable || genome.table_nodes.empty())
+            return;
+        for (auto node : genome.table_nodes)
+        {
+            auto table = this->judgement_cache.get(genome, node, dataset);
+            if (!table)
+            {
+                // (キャッシュが上限に達した場合は、区間ごとに表を作成します。)
+                shared_tables[i].clear();
+                table_pointers[i].clear();
+                break;
+            }
+            table_pointers[i].push_back(table->data());
+            shared_tables[i].push_back(std::move(table));
+        }
+    });
+
+    auto partial_sums = std::vector<double>(num_pending * num_chunks, 0.0);
+
+    // (作業領域はスレッドごとに用意します。)
+    auto record_outputs = config.max_num_outputs() * cols;
+    struct Workspace
+    {
+        std::vector<data_t> buffer;
+        std::vector<int> counts;
+        std::vector<data_t> gathered;
+        std::vector<std::uint64_t> visits;
+    };
+    auto workspaces = std::vector<Workspace>(threads->size());
+    threads->parallel_for(0, static_cast<int>(tasks.size()), [&](int task, int worker) {
+        auto &workspace = workspaces[worker];
+        auto &buffer = workspace.buffer;
+        auto &counts = workspace.counts;
+        auto &gathered = workspace.gathered;
+        auto &visits = workspace.visits;
+        buffer.resize(chunk_size * record_outputs);
+        counts.resize(chunk_size);
+        auto genome = tasks[task].first;
+        auto begin = tasks[task].second;
+        auto &compiled = compiled_genomes[genome];
+        auto &trace = traces[genome];
+        if (incremental[genome])
+        {
+            // 再評価するレコードを連続した領域に集めてノード遷移を行い、経路と評価指標の値を差し替えます。
+            // (同じ個体の他の区間と同じ要素を更新するため、経路は排他的に書き込みます。)
+            auto &records = reevaluated[genome];
+            auto end = std::min(begin + chunk_size, static_cast<int>(records.size()));
+            auto words = (chunk_size + 63) / 64;
+            gathered.resize(static_cast<size_t>(end - begin) * stride);
+            for (int i = begin; i < end; i++)
+                std::copy(inputs.row(records[i]).data(), inputs.row(records[i]).data() + stride, gathered.begin() + static_cast<size_t>(i - begin) * stride);
+            visits.assign(static_cast<size_t>(compiled.num_nodes()) * words, 0);
+            compiled.activate_frontier(gathered.data(), end - begin, stride, config, buffer.data(), counts.data(), visits.data(), words);
+            for (int i = begin; i < end; i++)
+            {
+                auto outputs = buffer.data() + (i - begin) * record_outputs;
+                trace->losses[records[i]] = metric.measure(config.output_attributes, outputs, counts[i - begin], targets.row(records[i]).data());
+            }
+            for (int node = 0; node < compiled.num_nodes(); node++)
+            {
+                auto *node_visits = trace->visits.data() + static_cast<size_t>(node) * trace->words;
+                for (int w = 0; w < words; w++)
+                {
+                    for (auto bits = visits[node * words + w]; bits; bits &= bits - 1)
+                    {
+                        auto record = records[begin + w * 64 + __builtin_ctzll(bits)];
+                        auto bit = std::uint64_t(1) << (record & 63);
+                        __atomic_fetch_or(&node_visits[record >> 6], bit, __ATOMIC_RELAXED);
+                    }
+                }
+            }
+            return;
+        }
+
+        auto end = std::min(begin + chunk_size, num_records);
+        if (trace)
+            compiled.activate_frontier(inputs.row(begin).data(), end - begin, stride, config, buffer.data(), counts.data(), trace->visits.data() + begin / 64, trace->words);
+        else if (!table_pointers[genome].empty())
+            compiled.activate_tables(table_pointers[genome].data(), begin, inputs.row(begin).data(), end - begin, stride, config, buffer.data(), counts.data());
+        else
+            compiled.activate_many(modes[genome], inputs.row(begin).data(), end - begin, stride, config, buffer.data(), counts.data());
+
+        auto sum = 0.0;
+        for (int i = begin; i < end; i++)
+        {
+            auto outputs = buffer.data() + (i - begin) * record_outputs;
+            auto value = metric.measure(config.output_attributes, outputs, counts[i - begin], targets.row(i).data());
+            if (trace)
+                trace->losses[i] = value;
+            sum += value;
+        }
+        partial_sums[genome * num_chunks + begin / chunk_size] = sum;
+    });
+
+    // 差分で評価した個体の総和を区間ごとに求め(計算順序は全レコードを評価する場合と同じです)、経路を登録します。
+    for (int i = 0; i < num_pending; i++)
+    {
+        if (!traces[i])
+            continue;
+        if (incremental[i])
+        {
+            auto &losses = traces[i]->losses;
+            for (int chunk = 0; chunk < num_chunks; chunk++)
+            {
+                auto begin = losses.begin() + chunk * chunk_size;
+                auto end = losses.begin() + std::min((chunk + 1) * chunk_size, num_records);
+                partial_sums[i * num_chunks + chunk] = std::accumulate(begin, end, 0.0);
+            }
+        }
+        auto num_evaluated = incremental[i] ? static_cast<long long>(reevaluated[i].size()) : num_records;
+        this->records_evaluated += num_evaluated;
+        this->records_reused += num_records - num_evaluated;
+        this->trace_cache.put(this->genomes[pending[i]].hash, std::move(traces[i]));
+    }
+
+    // 評価結果をキャッシュに登録し、キャッシュは現在の個体群の分だけを残します。
+    auto cache = std::unordered_map<std::uint64_t, double>();
+    cache.reserve(num_genomes);
+    for (int i = 0; i < num_pending; i++)
+    {
+        auto begin = partial_sums.begin() + i * num_chunks;
+        auto value = std::accumulate(begin, begin + num_chunks, 0.0) / std::max(num_records, 1);
+        cache.emplace(this->genomes[pending[i]].hash, value);
+    }
+    auto values = std::vector<double>(num_genomes);
+    for (int i = 0; i < num_genomes; i++)
+    {
+        auto &genome = this->genomes[i];
+        auto hash = genome.hash;
+        auto it = cache.find(hash);
+        if (it == cache.end())
+        {
+            auto cached = this->fitness_cache.find(hash);
+            auto value = cached != this->fitness_cache.end() ? cached->second : genome.metric_value;
+            it = cache.emplace(hash, value).first;
+        }
+        values[i] = it->second;
+        genome.metric_value = it->second;
+        genome.evaluation_key = key;
+        genome.fitness = metric.fitness(it->second);
+    }
+    this->fitness_cache = std::move(cache);
+    return values;
+}
+
+std::vector<EvolutionStatistics> Population::evolve(
+    const Dataset &dataset,
+    const GNPConfig &config,
+    const Metric &metric,
+    int num_generations,
+    const EarlyStopping &stopping,
+    const std::function<bool(const EvolutionStatistics &)> &callback,
+    int callback_interval,
+    ActivationMode mode)
+{
+    runtime_assert(0 <= num_generations, "Number of generations must not be negative.");
+    runtime_assert(0 < callback_interval, "Callback interval must be greater than 0.");
+
+    auto start = std::chrono::steady_clock::now();
+    auto history = std::vector<EvolutionStatistics>();
+    history.reserve(num_generations + 1);
+    auto best_fitness = -std::numeric_limits<double>::infinity();
+    auto stale_generations = 0;
+    for (int i = 0;; i++)
     {
-        auto num_offsprings = config.num_genomes - static_cast<int>(config.num_genomes * config.crossover_rate);
-        auto new_offsprings = std::vector<Genome>(num_offsprings);
-#pragma omp parallel for
-        for (int i = 0; i < num_offsprings; i++)
+        this->evaluate(dataset, config, metric, mode);
+
+        EvolutionStatistics statistics;
+        statistics.generation = this->generation;
+        statistics.best_fitness = -std::numeric_limits<double>::infinity();
+        statistics.best_metric_value = std::numeric_limits<double>::quiet_NaN();
+        auto sum = 0.0;
+        auto count = 0;
+        for (auto &genome : this->genomes)
         {
-#ifndef _OPENMP
-            auto &randomizer = this->randomizer;
-#else
-            auto &randomizer = this->randomizers[omp_get_thread_num()];
-#endif
-            auto &parent = parents[distribution(randomizer)];
-            Genome &offspring = new_offsprings[i];
-            offspring.configure_inheritance(parent);
-            offspring.mutate(randomizer, config);
+            if (std::isnan(genome.fitness))
+                continue;
+            if (statistics.best_fitness < genome.fitness)
+            {
+                statistics.best_fitness = genome.fitness;
+                statistics.best_metric_value = genome.metric_value;
+            }
+            sum += genome.fitness;
+            count++;
         }
-        auto begin = std::make_move_iterator(new_offsprings.begin());
-        auto end = std::make_move_iterator(new_offsprings.end());
-        offsprings.insert(offsprings.end(), begin, end);
+        statistics.mean_fitness = 0 < count ? sum / count : std::numeric_limits<double>::quiet_NaN();
+        statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        history.push_back(statistics);
+
+        // 早期終了の条件を判定します。
+        if (best_fitness + stopping.min_delta < statistics.best_fitness)
+        {
+            best_fitness = statistics.best_fitness;
+            stale_generations = 0;
+        }
+        else
+        {
+            stale_generations++;
+        }
+        auto stop = stopping.target_fitness <= statistics.best_fitness;
+        stop = stop || (0 < stopping.patience && stopping.patience <= stale_generations);
+        auto last = stop || i == num_generations;
+        if (callback && (i % callback_interval == 0 || last))
+            stop = callback(statistics) || stop;
+        if (stop || i == num_generations)
+            break;
+
+        this->run(config);
     }
+    return history;
+}
 
-    // エリート個体をコピーする。
+std::vector<EvolutionStatistics> Population::evolve_py(
+    const Dataset &dataset,
+    const GNPConfig &config,
+    int num_generations,
+    const std::string &metric_name,
+    const std::string &transform,
+    double scale,
+    double no_output_value,
+    const std::string &mode,
+    double target_fitness,
+    int patience,
+    double min_delta,
+    boost::python::object callback_py,
+    int callback_interval)
+{
+    namespace py = boost::python;
+
+    auto metric = Metric(metric_name, transform, scale, no_output_value);
+    auto activation_mode = to_activation_mode(mode);
+    EarlyStopping stopping;
+    stopping.target_fitness = target_fitness;
+    stopping.patience = patience;
+    stopping.min_delta = min_delta;
+
+    // (Python の例外は error_already_set として送出され、GIL を取得し直した後に Python 側で再送出されます。)
+    auto callback = std::function<bool(const EvolutionStatistics &)>();
+    if (!callback_py.is_none())
     {
-        auto num_offsprings = config.num_elites;
-        std::nth_element(
-            parents.begin(),
-            parents.begin() + config.num_elites,
-            parents.end(),
-            [](auto &parent1, auto &parent2) { return parent1.fitness > parent2.fitness; });
-        auto begin = std::make_move_iterator(parents.begin());
-        auto end = std::make_move_iterator(parents.begin() + num_offsprings);
-        offsprings.insert(offsprings.end(), begin, end);
+        callback = [&callback_py](const EvolutionStatistics &statistics) {
+            ScopedGILAcquire acquire;
+            auto result = callback_py(statistics);
+            return !result.is_none() && py::extract<bool>(result)();
+        };
     }
 
-    // 世代を更新する。
-    this->genomes = std::move(offsprings);
+    ScopedGILRelease release;
+    return this->evolve(dataset, config, metric, num_generations, stopping, callback, callback_interval, activation_mode);
+}
+
+bool Population::prepare_trace(const Genome &genome, int num_nodes, int num_records, std::shared_ptr<ActivationTrace> &trace, std::vector<int> &records)
+{
+    auto words = (num_records + 63) / 64;
+
+    // 親個体の経路から、変更されたノードを実行したレコードを求めます。
+    auto parent = TraceCache::trace_t();
+    if (genome.dirty_genes.size() == num_nodes)
+        parent = this->trace_cache.get(genome.parent_hash);
+    auto affected = std::vector<std::uint64_t>(words, 0);
+    auto num_affected = 0;
+    if (parent && parent->losses.size() == num_records)
+    {
+        for (int node = 0; node < num_nodes; node++)
+        {
+            if (!genome.dirty_genes[node])
+                continue;
+            const auto *node_visits = parent->visits.data() + static_cast<size_t>(node) * words;
+            for (int w = 0; w < words; w++)
+                affected[w] |= node_visits[w];
+        }
+        for (auto bits : affected)
+            num_affected += __builtin_popcountll(bits);
+    }
+
+    // 再評価するレコードが半数を超える場合は、全レコードを評価します。
+    if (!parent || parent->losses.size() != num_records || num_records < num_affected * 2)
+        return false;
+
+    // 再評価しないレコードの経路と評価指標の値は、親個体のものを引き継ぎます。
+    trace = std::make_shared<ActivationTrace>();
+    trace->words = words;
+    trace->visits.resize(static_cast<size_t>(num_nodes) * words);
+    for (int node = 0; node < num_nodes; node++)
+    {
+        const auto *source = parent->visits.data() + static_cast<size_t>(node) * words;
+        auto *destination = trace->visits.data() + static_cast<size_t>(node) * words;
+        for (int w = 0; w < words; w++)
+            destination[w] = source[w] & ~affected[w];
+    }
+    trace->losses = parent->losses;
+    records.clear();
+    records.reserve(num_affected);
+    for (int w = 0; w < words; w++)
+    {
+        for (auto bits = affected[w]; bits; bits &= bits - 1)
+            records.push_back(w * 64 + __builtin_ctzll(bits));
+    }
+    return true;
+}
+
+boost::python::numpy::ndarray Population::evaluate_py(
+    boost::python::numpy::ndarray inputs_py,
+    boost::python::numpy::ndarray targets_py,
+    const GNPConfig &config,
+    const std::string &metric,
+    const std::string &transform,
+    double scale,
+    double no_output_value,
+    const std::string &mode)
+{
+    auto dataset = Dataset(inputs_py, config.input_attributes, targets_py, config.output_attributes);
+    return this->evaluate_py(dataset, config, metric, transform, scale, no_output_value, mode);
+}
+
+boost::python::numpy::ndarray Population::evaluate_py(
+    const Dataset &dataset,
+    const GNPConfig &config,
+    const std::string &metric_name,
+    const std::string &transform,
+    double scale,
+    double no_output_value,
+    const std::string &mode)
+{
+    namespace py = boost::python;
+    namespace np = boost::python::numpy;
+
+    auto metric = Metric(metric_name, transform, scale, no_output_value);
+    auto activation_mode = to_activation_mode(mode);
+    std::vector<double> values;
+    {
+        ScopedGILRelease release;
+        values = this->evaluate(dataset, config, metric, activation_mode);
+    }
+
+    auto values_py = np::empty(py::make_tuple(values.size()), np::dtype::get_builtin<double>());
+    std::copy(values.begin(), values.end(), reinterpret_cast<double *>(values_py.get_data()));
+    return values_py;
+}
+
+void Population::activate_all(const Dataset &dataset, const GNPConfig &config, ActivationMode mode, double *outputs, bool *no_outputs)
+{
+    dataset.validate(config, false);
+    auto &inputs = dataset.inputs;
+    auto num_genomes = static_cast<int>(this->genomes.size());
+    auto num_records = static_cast<int>(inputs.rows());
+    auto stride = static_cast<int>(inputs.cols());
+    auto &attributes = config.output_attributes;
+    auto cols = static_cast<int>(attributes.size());
+    auto record_outputs = config.max_num_outputs() * cols;
+
+    // 内容が同じ個体は、最初の個体だけを実行して結果を複製します。
+    auto unique = std::vector<int>();
+    auto sources = std::vector<int>(num_genomes);
+    auto first_indices = std::unordered_map<std::uint64_t, int>();
+    for (int i = 0; i < num_genomes; i++)
+    {
+        auto inserted = first_indices.emplace(this->genomes[i].hash, i);
+        sources[i] = inserted.first->second;
+        if (inserted.second)
+            unique.push_back(i);
+    }
+
+    auto num_unique = static_cast<int>(unique.size());
+    auto compiled_genomes = std::vector<CompiledGenome>(num_unique);
+    auto modes = std::vector<ActivationMode>(num_unique, mode);
+    auto threads = this->thread_pool(config);
+    threads->parallel_for(0, num_unique, [&](int u, int worker) {
+        compiled_genomes[u] = CompiledGenome(this->genomes[unique[u]], config);
+        if (mode == ActivationMode::Auto)
+            modes[u] = compiled_genomes[u].select_mode(inputs.data(), num_records, stride, config);
+    });
+
+    // (個体, レコードの区間) の組ごとに並列に実行します。作業領域はスレッドごとに用意します。
+    constexpr int chunk_size = CompiledGenome::chunk_size;
+    auto num_chunks = (num_records + chunk_size - 1) / chunk_size;
+    struct Workspace
+    {
+        std::vector<data_t> buffer;
+        std::vector<int> counts;
+    };
+    auto workspaces = std::vector<Workspace>(threads->size());
+    threads->parallel_for(0, num_unique * num_chunks, [&](int task, int worker) {
+        auto &workspace = workspaces[worker];
+        workspace.buffer.resize(chunk_size * record_outputs);
+        workspace.counts.resize(chunk_size);
+        auto u = task / num_chunks;
+        auto begin = (task % num_chunks) * chunk_size;
+        auto end = std::min(begin + chunk_size, num_records);
+        compiled_genomes[u].activate_many(modes[u], inputs.row(begin).data(), end - begin, stride, config, workspace.buffer.data(), workspace.counts.data());
+
+        auto genome = static_cast<size_t>(unique[u]);
+        for (int i = begin; i < end; i++)
+        {
+            auto record = genome * num_records + i;
+            auto source = workspace.buffer.data() + (i - begin) * record_outputs;
+            auto dest = outputs + record * cols;
+            no_outputs[record] = workspace.counts[i - begin] == 0;
+            for (int j = 0; j < cols; j++)
+            {
+                if (no_outputs[record])
+                    dest[j] = std::numeric_limits<double>::quiet_NaN();
+                else if (attributes[j].type == DataAttributeType::Category)
+                    dest[j] = static_cast<double>(source[j].category);
+                else
+                    dest[j] = static_cast<double>(source[j].numeric);
+            }
+        }
+    });
+
+    threads->parallel_for(0, num_genomes, [&](int i, int worker) {
+        if (sources[i] == i)
+            return;
+        auto size = static_cast<size_t>(num_records);
+        std::copy(outputs + sources[i] * size * cols, outputs + (sources[i] + 1) * size * cols, outputs + i * size * cols);
+        std::copy(no_outputs + sources[i] * size, no_outputs + (sources[i] + 1) * size, no_outputs + i * size);
+    });
+}
+
+boost::python::tuple Population::activate_all_py(const Dataset &dataset, const GNPConfig &config, const std::string &mode)
+{
+    namespace py = boost::python;
+    namespace np = boost::python::numpy;
+
+    dataset.validate(config, false);
+    auto activation_mode = to_activation_mode(mode);
+    auto num_genomes = this->genomes.size();
+    auto num_records = dataset.num_records();
+    auto outputs_py = np::empty(py::make_tuple(num_genomes, num_records, config.output_attributes.size()), np::dtype::get_builtin<double>());
+    auto no_outputs_py = np::empty(py::make_tuple(num_genomes, num_records), np::dtype::get_builtin<bool>());
+    auto outputs = reinterpret_cast<double *>(outputs_py.get_data());
+    auto no_outputs = reinterpret_cast<bool *>(no_outputs_py.get_data());
+    {
+        ScopedGILRelease release;
+        this->activate_all(dataset, config, activation_mode, outputs, no_outputs);
+    }
+    return py::make_tuple(outputs_py, no_outputs_py);
+}
+
+boost::python::numpy::ndarray Population::get_fitnesses_py() const
+{
+    namespace py = boost::python;
+    namespace np = boost::python::numpy;
+
+    auto fitnesses_py = np::empty(py::make_tuple(this->genomes.size()), np::dtype::get_builtin<double>());
+    auto fitnesses = reinterpret_cast<double *>(fitnesses_py.get_data());
+    for (int i = 0; i < this->genomes.size(); i++)
+        fitnesses[i] = this->genomes[i].fitness;
+    return fitnesses_py;
+}
+
+void Population::set_fitnesses_py(boost::python::numpy::ndarray fitnesses_py)
+{
+    namespace py = boost::python;
+    namespace np = boost::python::numpy;
+
+    runtime_assert(fitnesses_py.get_nd() == 1, "ndim must be 1.");
+    runtime_assert(py::len(fitnesses_py) == this->genomes.size(), "fitnesses length does not match the number of genomes.");
+
+    // (任意の型と配置の ndarray を受け付けるため、float64 の連続した配列に変換してから読み込みます。)
+    auto values_py = np::from_object(fitnesses_py, np::dtype::get_builtin<double>(), np::ndarray::C_CONTIGUOUS);
+    auto values = reinterpret_cast<const double *>(values_py.get_data());
+    for (int i = 0; i < this->genomes.size(); i++)
+    {
+        auto &genome = this->genomes[i];
+        genome.fitness = values[i];
+        genome.metric_value = values[i];
+        genome.evaluation_key = 0;
+    }
 }
 
 void Population::serialize(const char *path, const GNPConfig &config) const
@@ -145,6 +750,16 @@ void Population::deserialize(const char *path, const GNPConfig &config)
     }
 }
 
+long long Population::get_gene_allocations() const
+{
+    return std::accumulate(this->pools.begin(), this->pools.end(), 0LL, [](long long sum, auto &pool) { return sum + pool.allocations; });
+}
+
+long long Population::get_gene_reuses() const
+{
+    return std::accumulate(this->pools.begin(), this->pools.end(), 0LL, [](long long sum, auto &pool) { return sum + pool.reuses; });
+}
+
 bool Population::equal_to(const Population &other) const
 {
     auto &group1 = this->genomes;
@@ -1,24 +1,156 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <random>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+
+#include "ActivationMode.h"
+#include "CompiledGenome.h"
+#include "Dataset.h"
+#include "GenePool.h"
 #include "GNPConfig.h"
 #include "GNPTypes.h"
 #include "Genome.h"
+#include "JudgementCache.h"
+#include "Metric.h"
+#include "Selection.h"
+#include "ThreadPool.h"
+#include "TraceCache.h"
 
 namespace gnp
 {
+// 1 世代の評価結果の要約です。
+struct EvolutionStatistics
+{
+    // 世代。
+    std::uint64_t generation = 0;
+
+    // 適合度の最大値と平均値(NaN の個体は除きます)。
+    double best_fitness = 0.0;
+    double mean_fitness = 0.0;
+
+    // 適合度が最も高い個体の評価指標の値。
+    double best_metric_value = 0.0;
+
+    // 進化を開始してからの経過時間(秒)。
+    double seconds = 0.0;
+
+    // 全ての値が等しい場合に等しいとみなします。
+    friend bool operator==(const EvolutionStatistics &a, const EvolutionStatistics &b)
+    {
+        return a.generation == b.generation && a.best_fitness == b.best_fitness && a.mean_fitness == b.mean_fitness &&
+               a.best_metric_value == b.best_metric_value && a.seconds == b.seconds;
+    }
+};
+
+// 進化を早期に終了する条件です。
+struct EarlyStopping
+{
+    // 適合度の最大値がこの値以上になった場合に終了します。
+    double target_fitness = std::numeric_limits<double>::infinity();
+
+    // 適合度の最大値が min_delta を超えて改善しない世代が patience 世代続いた場合に終了します(0 の場合は判定しません)。
+    int patience = 0;
+    double min_delta = 0.0;
+};
+
 // すべての遺伝子を表します。
 class Population
 {
   public:
-    // このクラスのインスタンスを初期化します。
+    // このクラスのインスタンスを初期化します(config.seed が負の場合は、ランダムなシードを使用します)。
     Population(const GNPConfig &config);
 
+    // 指定されたシードでこのクラスのインスタンスを初期化します。
+    Population(const GNPConfig &config, std::uint64_t seed);
+
+    // (スレッドごとのノードのプールは複製できないため、移動だけを許可します。)
+    Population(const Population &) = delete;
+
+    Population(Population &&) = default;
+
     // 全個体に対して遺伝子操作を行い、世代を更新します。
     void run(const GNPConfig &config);
 
+    // 全個体をデータセット全体で評価し、各個体の適合度を更新します。
+    // 戻り値は各個体の評価指標の値です。
+    std::vector<double> evaluate(const Dataset &dataset, const GNPConfig &config, const Metric &metric, ActivationMode mode = ActivationMode::Auto);
+
+    // 評価と世代の更新を繰り返し、num_generations 世代進化させます(終了時の個体群は評価済みです)。
+    // 各世代の評価後に stopping の条件を判定し、callback_interval 世代ごとと最後の世代では callback を呼び出します。
+    // callback が true を返した場合も終了します。戻り値は評価した各世代の要約です。
+    std::vector<EvolutionStatistics> evolve(
+        const Dataset &dataset,
+        const GNPConfig &config,
+        const Metric &metric,
+        int num_generations,
+        const EarlyStopping &stopping = EarlyStopping(),
+        const std::function<bool(const EvolutionStatistics &)> &callback = nullptr,
+        int callback_interval = 1,
+        ActivationMode mode = ActivationMode::Auto);
+
+    // num_generations 世代進化させます(進化の間は GIL を解放し、callback を呼び出す間だけ取得します)。
+    // callback は EvolutionStatistics を引数に呼び出され、True を返すと終了します。
+    std::vector<EvolutionStatistics> evolve_py(
+        const Dataset &dataset,
+        const GNPConfig &config,
+        int num_generations,
+        const std::string &metric,
+        const std::string &transform,
+        double scale,
+        double no_output_value,
+        const std::string &mode,
+        double target_fitness,
+        int patience,
+        double min_delta,
+        boost::python::object callback,
+        int callback_interval);
+
+    // 全個体をデータセット全体で評価し、各個体の適合度を更新します。
+    boost::python::numpy::ndarray evaluate_py(
+        boost::python::numpy::ndarray inputs,
+        boost::python::numpy::ndarray targets,
+        const GNPConfig &config,
+        const std::string &metric,
+        const std::string &transform,
+        double scale,
+        double no_output_value,
+        const std::string &mode);
+
+    // 全個体をデータセット全体で評価し、各個体の適合度を更新します。
+    boost::python::numpy::ndarray evaluate_py(
+        const Dataset &dataset,
+        const GNPConfig &config,
+        const std::string &metric,
+        const std::string &transform,
+        double scale,
+        double no_output_value,
+        const std::string &mode);
+
+    // 全個体をデータセットの全レコードに対して並列に実行し、各レコードの出力の 1 行目(評価指標で推定値とみなす行)を書き込みます。
+    // outputs には (個体数, レコード数, 出力属性数) の領域が、no_outputs には (個体数, レコード数) の領域が必要です。
+    // 出力がないレコードは outputs を NaN で埋め、no_outputs を true にします。内容が同じ個体は 1 度だけ実行します。
+    void activate_all(const Dataset &dataset, const GNPConfig &config, ActivationMode mode, double *outputs, bool *no_outputs);
+
+    // 全個体を実行し、出力 (個体数, レコード数, 出力属性数) の ndarray (float64) と、
+    // 出力がないことを表すマスク (個体数, レコード数) の ndarray (bool) の組を返します(実行の間は GIL を解放します)。
+    boost::python::tuple activate_all_py(const Dataset &dataset, const GNPConfig &config, const std::string &mode);
+
+    // 全個体の適合度を (個体数,) の ndarray (float64) で取得します。
+    boost::python::numpy::ndarray get_fitnesses_py() const;
+
+    // 全個体の適合度を (個体数,) の ndarray から設定します(Python で計算した適合度を一度に書き戻す場合に使用します)。
+    // 設定した適合度は評価指標による評価結果とはみなさず、親個体からの適合度の引き継ぎにも使用しません。
+    void set_fitnesses_py(boost::python::numpy::ndarray fitnesses);
+
     // 指定されたファイルに個体群を保存します。
     void serialize(const char *path, const GNPConfig &config) const;
 
@@ -29,15 +161,67 @@ class Population
 
     bool not_equal_to(const Population &other) const;
 
+    // ヒープ領域に確保したノードの数を取得します。
+    long long get_gene_allocations() const;
+
+    // 破棄された個体から再利用したノードの数を取得します。
+    long long get_gene_reuses() const;
+
+    // 評価結果に影響する設定(データセット、ノードの実行時間、評価指標)から求めたハッシュ値(Genome::evaluation_key に設定される値)。
+    static std::uint64_t evaluation_key(const Dataset &dataset, const GNPConfig &config, const Metric &metric);
+
+    // config.num_threads に従ってスレッドプールを取得し(ThreadPool::instance を参照)、そのスレッド数の分だけノードのプールを用意します。
+    // 並列処理を行う間は戻り値を保持します。
+    std::shared_ptr<ThreadPool> thread_pool(const GNPConfig &config);
+
   public:
     // 遺伝子の集合。
     std::vector<Genome> genomes;
 
+    // 乱数のシード。
+    std::uint64_t seed;
+
+    // 現在の世代(初期の個体群は 0 で、run を呼び出すごとに 1 ずつ増えます)。
+    std::uint64_t generation = 0;
+
+    // 実行方式が BranchTable の個体で共有する判定ノードのブランチの表。
+    JudgementCache judgement_cache;
+
+    // 評価を省略した個体の数と、評価を行った個体の数。
+    long long fitness_cache_hits = 0;
+    long long fitness_cache_misses = 0;
+
+    // 親個体の適合度を引き継いで評価を省略した個体の数。
+    long long fitness_inherited = 0;
+
+    // 評価した個体のノード遷移の経路。
+    TraceCache trace_cache;
+
+    // 経路を記録しながら評価した個体で、ノード遷移を行ったレコードの数と、親個体の評価結果を再利用したレコードの数。
+    long long records_evaluated = 0;
+    long long records_reused = 0;
+
   private:
-#ifndef _OPENMP
-    randomizer_t randomizer;
-#else
-    std::vector<randomizer_t> randomizers;
-#endif
+    // 親個体の経路を再利用できる場合は、個体のノード遷移の経路を記録する領域を trace に作成し、
+    // 変更されたノードを実行したレコードを records に格納し、それ以外のレコードの経路と評価指標の値を親個体から引き継いで true を返します。
+    // 再利用できない場合は trace を作成せずに false を返します。
+    bool prepare_trace(const Genome &genome, int num_nodes, int num_records, std::shared_ptr<ActivationTrace> &trace, std::vector<int> &records);
+
+    // 前回評価した個体のハッシュ値から評価指標の値への対応と、その評価の設定のハッシュ値。
+    std::unordered_map<std::uint64_t, double> fitness_cache;
+    std::uint64_t fitness_cache_key = 0;
+
+    // 前の世代の個体群(世代の更新で、子個体の領域として再利用します)。
+    std::vector<Genome> spare_genomes;
+
+    // 親個体の選択方式と、その選択の表。
+    Selection selection;
+
+    // 世代の更新で使用する作業領域。
+    std::vector<int> parent_indices;
+    std::vector<std::uint64_t> selected_hashes;
+
+    // スレッドごとのノードのプール。
+    std::vector<GenePool> pools;
 };
 }
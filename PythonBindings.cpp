@@ -2,12 +2,20 @@
 #include <boost/python/numpy.hpp>
 #include <boost/python/suite/indexing/vector_indexing_suite.hpp>
 
+#include "CompiledGenome.h"
 #include "DataAttribute.h"
 #include "DataAttributeCollection.h"
+#include "Dataset.h"
+#include "EvaluationFarm.h"
 #include "GNPConfig.h"
 #include "Genome.h"
+#include "IslandPopulation.h"
+#include "JudgementCache.h"
 #include "NodeGene.h"
 #include "Population.h"
+#include "SteadyStateEngine.h"
+#include "ThreadPool.h"
+#include "TraceCache.h"
 
 using namespace gnp;
 
@@ -19,6 +27,20 @@ BOOST_PYTHON_MODULE(gnp)
     Py_Initialize();
     np::initialize();
 
+    // (オーバーロードされたメンバ関数の選択。)
+    np::ndarray (Genome::*genome_activate_batch_ndarray)(np::ndarray, const GNPConfig &, const std::string &) const = &Genome::activate_batch_py;
+    np::ndarray (Genome::*genome_activate_batch_dataset)(const Dataset &, const GNPConfig &, const std::string &) const = &Genome::activate_batch_py;
+    np::ndarray (CompiledGenome::*compiled_genome_activate_batch_ndarray)(np::ndarray, const GNPConfig &, const std::string &) const = &CompiledGenome::activate_batch_py;
+    np::ndarray (CompiledGenome::*compiled_genome_activate_batch_dataset)(const Dataset &, const GNPConfig &, const std::string &) const = &CompiledGenome::activate_batch_py;
+    np::ndarray (Population::*population_evaluate_ndarray)(np::ndarray, np::ndarray, const GNPConfig &, const std::string &, const std::string &, double, double, const std::string &) = &Population::evaluate_py;
+    np::ndarray (Population::*population_evaluate_dataset)(const Dataset &, const GNPConfig &, const std::string &, const std::string &, double, double, const std::string &) = &Population::evaluate_py;
+    void (IslandPopulation::*island_population_evolve_ndarray)(np::ndarray, np::ndarray, int, const std::string &, const std::string &, double, double, const std::string &) = &IslandPopulation::evolve_py;
+    void (IslandPopulation::*island_population_evolve_dataset)(const Dataset &, int, const std::string &, const std::string &, double, double, const std::string &) = &IslandPopulation::evolve_py;
+
+    // 並列処理に使用するスレッド数(呼び出し元のスレッドを含みます。0 以下を設定すると既定値に戻します)。
+    py::def("set_num_threads", &ThreadPool::set_num_threads, py::arg("num_threads"));
+    py::def("get_num_threads", &ThreadPool::get_num_threads);
+
     py::class_<DataAttribute>("DataAttribute")
         .add_property("name", &DataAttribute::get_name)
         .add_property("typename", &DataAttribute::get_typename)
@@ -30,6 +52,12 @@ BOOST_PYTHON_MODULE(gnp)
     py::class_<DataAttributeCollection>("DataAttributeCollection")
         .def("__str__", &DataAttributeCollection::to_string);
 
+    py::class_<Dataset>("Dataset", py::init<np::ndarray, const DataAttributeCollection &>())
+        .def(py::init<np::ndarray, const DataAttributeCollection &, np::ndarray, const DataAttributeCollection &>())
+        .add_property("num_records", &Dataset::num_records)
+        .add_property("has_targets", &Dataset::has_targets)
+        .def("__len__", &Dataset::num_records);
+
     py::class_<GNPConfig>("GNPConfig", py::init<const char *>())
         .def_readonly("input_attributes", &GNPConfig::input_attributes)
         .def_readonly("output_attributes", &GNPConfig::output_attributes)
@@ -44,9 +72,16 @@ BOOST_PYTHON_MODULE(gnp)
         .def_readwrite("data_source_mutation_rate", &GNPConfig::data_source_mutation_rate)
         .def_readwrite("judgement_function_mutation_rate", &GNPConfig::judgement_function_mutation_rate)
         .def_readwrite("output_mutation_rate", &GNPConfig::output_mutation_rate)
+        .add_property("selection", &GNPConfig::get_selection, &GNPConfig::set_selection)
+        .add_property("tournament_size", &GNPConfig::get_tournament_size, &GNPConfig::set_tournament_size)
+        .add_property("rank_selection_pressure", &GNPConfig::get_rank_selection_pressure, &GNPConfig::set_rank_selection_pressure)
+        .add_property("truncation_rate", &GNPConfig::get_truncation_rate, &GNPConfig::set_truncation_rate)
+        .def_readwrite("seed", &GNPConfig::seed)
+        .def_readwrite("num_threads", &GNPConfig::num_threads)
         .def_readonly("time_limit", &GNPConfig::time_limit)
         .def_readonly("delay_time_processing_node", &GNPConfig::delay_time_processing_node)
-        .def_readonly("delay_time_judgement_node", &GNPConfig::delay_time_judgement_node);
+        .def_readonly("delay_time_judgement_node", &GNPConfig::delay_time_judgement_node)
+        .add_property("max_num_outputs", &GNPConfig::max_num_outputs);
 
     py::class_<Genome>("Genome")
         .def("configure_new", &Genome::configure_new_py)
@@ -57,18 +92,113 @@ BOOST_PYTHON_MODULE(gnp)
         .def("deserialize", &Genome::deserialize)
         .def("savefig", &Genome::savefig)
         .def("activate", &Genome::activate_py)
+        .def("activate", &Genome::activate_into_py, (py::arg("vector"), py::arg("config"), py::arg("out")))
+        .def("activate_batch", genome_activate_batch_ndarray, (py::arg("matrix"), py::arg("config"), py::arg("mode") = "auto"))
+        .def("activate_batch", genome_activate_batch_dataset, (py::arg("dataset"), py::arg("config"), py::arg("mode") = "auto"))
         .def_readwrite("fitness", &Genome::fitness)
+        .def_readonly("hash", &Genome::hash)
+        .def_readonly("inherits_fitness", &Genome::inherits_fitness)
+        .add_property("inheritance_reason", &Genome::get_inheritance_reason)
         .def("__eq__", &Genome::equal_to)
         .def("__ne__", &Genome::not_equal_to);
 
+    py::class_<CompiledGenome>("CompiledGenome", py::init<const Genome &, const GNPConfig &>())
+        .def("activate", &CompiledGenome::activate_py)
+        .def("activate", &CompiledGenome::activate_into_py, (py::arg("vector"), py::arg("config"), py::arg("out")))
+        .def("activate_batch", compiled_genome_activate_batch_ndarray, (py::arg("matrix"), py::arg("config"), py::arg("mode") = "auto"))
+        .def("activate_batch", compiled_genome_activate_batch_dataset, (py::arg("dataset"), py::arg("config"), py::arg("mode") = "auto"));
+
+    py::class_<JudgementCache, boost::noncopyable>("JudgementCache", py::no_init)
+        .add_property("hits", &JudgementCache::get_hits)
+        .add_property("misses", &JudgementCache::get_misses)
+        .add_property("size", &JudgementCache::get_size)
+        .add_property("bytes", &JudgementCache::get_bytes)
+        .def_readwrite("max_bytes", &JudgementCache::max_bytes)
+        .def("clear", &JudgementCache::clear)
+        .def("reset_statistics", &JudgementCache::reset_statistics);
+
+    py::class_<TraceCache, boost::noncopyable>("TraceCache", py::no_init)
+        .add_property("hits", &TraceCache::get_hits)
+        .add_property("misses", &TraceCache::get_misses)
+        .add_property("size", &TraceCache::get_size)
+        .add_property("bytes", &TraceCache::get_bytes)
+        .def_readwrite("max_bytes", &TraceCache::max_bytes)
+        .def("clear", &TraceCache::clear)
+        .def("reset_statistics", &TraceCache::reset_statistics);
+
     py::class_<std::vector<Genome>>("std::vector<Genome>")
         .def(py::vector_indexing_suite<std::vector<Genome>>());
 
-    py::class_<Population>("Population", py::init<const GNPConfig &>())
+    py::class_<EvolutionStatistics>("EvolutionStatistics", py::no_init)
+        .def_readonly("generation", &EvolutionStatistics::generation)
+        .def_readonly("best_fitness", &EvolutionStatistics::best_fitness)
+        .def_readonly("mean_fitness", &EvolutionStatistics::mean_fitness)
+        .def_readonly("best_metric_value", &EvolutionStatistics::best_metric_value)
+        .def_readonly("seconds", &EvolutionStatistics::seconds);
+
+    py::class_<std::vector<EvolutionStatistics>>("std::vector<EvolutionStatistics>")
+        .def(py::vector_indexing_suite<std::vector<EvolutionStatistics>>());
+
+    py::class_<Population, boost::noncopyable>("Population", py::init<const GNPConfig &>())
+        .def(py::init<const GNPConfig &, std::uint64_t>((py::arg("config"), py::arg("seed"))))
         .def("run", &Population::run)
+        .def("evaluate", population_evaluate_ndarray, (py::arg("inputs"), py::arg("targets"), py::arg("config"), py::arg("metric") = "mse", py::arg("transform") = "auto", py::arg("scale") = 1.0, py::arg("no_output_value") = 0.0, py::arg("mode") = "auto"))
+        .def("evolve", &Population::evolve_py, (py::arg("dataset"), py::arg("config"), py::arg("num_generations"), py::arg("metric") = "mse", py::arg("transform") = "auto", py::arg("scale") = 1.0, py::arg("no_output_value") = 0.0, py::arg("mode") = "auto", py::arg("target_fitness") = std::numeric_limits<double>::infinity(), py::arg("patience") = 0, py::arg("min_delta") = 0.0, py::arg("callback") = py::object(), py::arg("callback_interval") = 1))
+        .def("evaluate", population_evaluate_dataset, (py::arg("dataset"), py::arg("config"), py::arg("metric") = "mse", py::arg("transform") = "auto", py::arg("scale") = 1.0, py::arg("no_output_value") = 0.0, py::arg("mode") = "auto"))
+        .def("activate_all", &Population::activate_all_py, (py::arg("dataset"), py::arg("config"), py::arg("mode") = "auto"))
         .def("serialize", &Population::serialize)
         .def("deserialize", &Population::deserialize)
+        .add_property("fitnesses", &Population::get_fitnesses_py, &Population::set_fitnesses_py)
         .def_readonly("genomes", &Population::genomes)
+        .def_readonly("seed", &Population::seed)
+        .def_readonly("generation", &Population::generation)
+        .def_readonly("judgement_cache", &Population::judgement_cache)
+        .def_readonly("fitness_cache_hits", &Population::fitness_cache_hits)
+        .def_readonly("fitness_cache_misses", &Population::fitness_cache_misses)
+        .def_readonly("fitness_inherited", &Population::fitness_inherited)
+        .def_readonly("trace_cache", &Population::trace_cache)
+        .def_readonly("records_evaluated", &Population::records_evaluated)
+        .def_readonly("records_reused", &Population::records_reused)
+        .add_property("gene_allocations", &Population::get_gene_allocations)
+        .add_property("gene_reuses", &Population::get_gene_reuses)
         .def("__eq__", &Population::equal_to)
         .def("__ne__", &Population::not_equal_to);
+
+    py::class_<SteadyStateEngine, boost::noncopyable>("SteadyStateEngine", py::init<int>((py::arg("max_in_flight") = 0)))
+        .def("run", &SteadyStateEngine::run_py, (py::arg("population"), py::arg("dataset"), py::arg("config"), py::arg("num_evaluations"), py::arg("metric") = "mse", py::arg("transform") = "auto", py::arg("scale") = 1.0, py::arg("no_output_value") = 0.0, py::arg("mode") = "auto"))
+        .add_property("throughput", &SteadyStateEngine::get_throughput)
+        .def_readwrite("max_in_flight", &SteadyStateEngine::max_in_flight)
+        .def_readonly("offsprings", &SteadyStateEngine::offsprings)
+        .def_readonly("inherited", &SteadyStateEngine::inherited)
+        .def_readonly("replacements", &SteadyStateEngine::replacements)
+        .def_readonly("last_offsprings", &SteadyStateEngine::last_offsprings)
+        .def_readonly("last_seconds", &SteadyStateEngine::last_seconds);
+
+    py::class_<EvaluationFarm, boost::noncopyable>("EvaluationFarm", py::init<py::object, py::object, const GNPConfig &, int>((py::arg("fitness"), py::arg("dataset"), py::arg("config"), py::arg("num_workers"))))
+        .def("evaluate", &EvaluationFarm::evaluate_py)
+        .def("close", &EvaluationFarm::close)
+        .add_property("num_workers", &EvaluationFarm::get_num_workers)
+        .def_readonly("genomes_sent", &EvaluationFarm::genomes_sent)
+        .def_readonly("bytes_sent", &EvaluationFarm::bytes_sent);
+
+    py::class_<IslandStatistics>("IslandStatistics", py::no_init)
+        .def_readonly("generation", &IslandStatistics::generation)
+        .def_readonly("best_fitness", &IslandStatistics::best_fitness)
+        .def_readonly("mean_fitness", &IslandStatistics::mean_fitness)
+        .def_readonly("migrants_sent", &IslandStatistics::migrants_sent)
+        .def_readonly("migrants_received", &IslandStatistics::migrants_received);
+
+    py::class_<std::vector<IslandStatistics>>("std::vector<IslandStatistics>")
+        .def(py::vector_indexing_suite<std::vector<IslandStatistics>>());
+
+    py::class_<IslandPopulation, boost::noncopyable>("IslandPopulation", py::init<const GNPConfig &, int, int, int>((py::arg("config"), py::arg("num_islands"), py::arg("migration_interval") = 10, py::arg("num_migrants") = 1)))
+        .def("evolve", island_population_evolve_ndarray, (py::arg("inputs"), py::arg("targets"), py::arg("num_generations"), py::arg("metric") = "mse", py::arg("transform") = "auto", py::arg("scale") = 1.0, py::arg("no_output_value") = 0.0, py::arg("mode") = "auto"))
+        .def("evolve", island_population_evolve_dataset, (py::arg("dataset"), py::arg("num_generations"), py::arg("metric") = "mse", py::arg("transform") = "auto", py::arg("scale") = 1.0, py::arg("no_output_value") = 0.0, py::arg("mode") = "auto"))
+        .def("island", &IslandPopulation::get_island, py::return_internal_reference<>())
+        .def("config", &IslandPopulation::get_config, py::return_internal_reference<>())
+        .add_property("num_islands", &IslandPopulation::get_num_islands)
+        .add_property("best_genome", &IslandPopulation::get_best_genome)
+        .def_readonly("statistics", &IslandPopulation::statistics)
+        .def_readwrite("migration_interval", &IslandPopulation::migration_interval)
+        .def_readwrite("num_migrants", &IslandPopulation::num_migrants);
 }
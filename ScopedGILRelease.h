@@ -0,0 +1,45 @@
+#pragma once
+
+#include <Python.h>
+
+namespace gnp
+{
+// スコープの間だけ Python の GIL を解放します。
+// (解放中は Python のオブジェクトに触れてはいけません。)
+class ScopedGILRelease
+{
+  public:
+    ScopedGILRelease() : state(PyEval_SaveThread()) {}
+
+    ~ScopedGILRelease()
+    {
+        PyEval_RestoreThread(this->state);
+    }
+
+    ScopedGILRelease(const ScopedGILRelease &) = delete;
+
+    ScopedGILRelease &operator=(const ScopedGILRelease &) = delete;
+
+  private:
+    PyThreadState *state;
+};
+
+// スコープの間だけ Python の GIL を取得します(ScopedGILRelease で解放している間に Python の関数を呼び出す場合に使用します)。
+class ScopedGILAcquire
+{
+  public:
+    ScopedGILAcquire() : state(PyGILState_Ensure()) {}
+
+    ~ScopedGILAcquire()
+    {
+        PyGILState_Release(this->state);
+    }
+
+    ScopedGILAcquire(const ScopedGILAcquire &) = delete;
+
+    ScopedGILAcquire &operator=(const ScopedGILAcquire &) = delete;
+
+  private:
+    PyGILState_STATE state;
+};
+}
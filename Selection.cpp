@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "GNPConfig.h"
+#include "Genome.h"
+#include "Selection.h"
+#include "format.h"
+#include "runtime_assert.h"
+
+namespace gnp
+{
+SelectionType to_selection_type(std::string name)
+{
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    if (name == "roulette")
+        return SelectionType::Roulette;
+    if (name == "tournament")
+        return SelectionType::Tournament;
+    if (name == "rank")
+        return SelectionType::Rank;
+    if (name == "truncation")
+        return SelectionType::Truncation;
+    runtime_assert(false, format("'{0}' is invalid selection type.", name));
+    return SelectionType::Roulette;
+}
+
+std::string to_string(SelectionType type)
+{
+    switch (type)
+    {
+    case SelectionType::Roulette:
+        return "roulette";
+    case SelectionType::Tournament:
+        return "tournament";
+    case SelectionType::Rank:
+        return "rank";
+    case SelectionType::Truncation:
+        return "truncation";
+    }
+    return "";
+}
+
+void Selection::prepare(const std::vector<Genome> &genomes, const GNPConfig &config)
+{
+    auto num_genomes = static_cast<int>(genomes.size());
+    runtime_assert(0 < num_genomes, "Population is empty.");
+    this->type = config.selection;
+    this->tournament_size = config.tournament_size;
+    this->fitnesses.resize(num_genomes);
+    std::transform(genomes.begin(), genomes.end(), this->fitnesses.begin(), [](auto &genome) {
+        return genome.fitness;
+    });
+
+    switch (this->type)
+    {
+    case SelectionType::Roulette:
+    {
+        // 負の適合度を含む場合は、最小値を引いて 0 以上の重みにします(最小の個体の重みは 0 になります)。
+        // (変換方法 'negative' などでは適合度が常に負になるため、終了せずに選択できるようにします。)
+        auto minimum = 0.0;
+        for (auto fitness : this->fitnesses)
+        {
+            if (!std::isnan(fitness))
+                minimum = std::min(minimum, fitness);
+        }
+        this->weights.resize(num_genomes);
+        for (int i = 0; i < num_genomes; i++)
+        {
+            // (NaN の個体は選択しません。)
+            auto weight = this->fitnesses[i] - minimum;
+            this->weights[i] = 0.0 <= weight ? weight : 0.0;
+        }
+
+        // 適合度が無限大の個体がある場合は、それらの個体から一様に選択します。
+        if (std::any_of(this->weights.begin(), this->weights.end(), [](double weight) { return std::isinf(weight); }))
+        {
+            std::transform(this->weights.begin(), this->weights.end(), this->weights.begin(), [](double weight) {
+                return std::isinf(weight) ? 1.0 : 0.0;
+            });
+        }
+        this->build_alias_table(this->weights);
+        break;
+    }
+    case SelectionType::Tournament:
+        // (適合度の比較だけで選択するため、表は作成しません。)
+        break;
+    case SelectionType::Rank:
+    {
+        // 順位 r (0 が最上位) の重みは sp - 2 (sp - 1) r / (N - 1) です。
+        this->sort_order(num_genomes);
+        auto pressure = config.rank_selection_pressure;
+        this->weights.resize(num_genomes);
+        for (int r = 0; r < num_genomes; r++)
+        {
+            auto position = num_genomes == 1 ? 0.0 : static_cast<double>(r) / (num_genomes - 1);
+            this->weights[r] = pressure - 2.0 * (pressure - 1.0) * position;
+        }
+        this->build_alias_table(this->weights);
+        break;
+    }
+    case SelectionType::Truncation:
+    {
+        auto count = static_cast<int>(std::ceil(config.truncation_rate * num_genomes));
+        this->sort_order(std::min(std::max(count, 1), num_genomes));
+        break;
+    }
+    }
+}
+
+int Selection::select(randomizer_t &randomizer) const
+{
+    auto num_genomes = static_cast<int>(this->fitnesses.size());
+    switch (this->type)
+    {
+    case SelectionType::Roulette:
+    case SelectionType::Rank:
+    {
+        auto size = static_cast<int>(this->alias_probabilities.size());
+        auto i = std::uniform_int_distribution<int>(0, size - 1)(randomizer);
+        auto u = std::uniform_real_distribution<double>(0.0, 1.0)(randomizer);
+        auto index = u < this->alias_probabilities[i] ? i : this->alias_indices[i];
+        return this->type == SelectionType::Rank ? this->order[index] : index;
+    }
+    case SelectionType::Tournament:
+    {
+        auto dice = std::uniform_int_distribution<int>(0, num_genomes - 1);
+        auto best = dice(randomizer);
+        for (int k = 1; k < this->tournament_size; k++)
+        {
+            auto index = dice(randomizer);
+            if (is_better_fitness(this->fitnesses[index], this->fitnesses[best]))
+                best = index;
+        }
+        return best;
+    }
+    case SelectionType::Truncation:
+        return this->order[std::uniform_int_distribution<int>(0, this->num_candidates - 1)(randomizer)];
+    }
+    return 0;
+}
+
+void Selection::build_alias_table(const std::vector<double> &weights)
+{
+    // Vose の方法で、各区画 i に「確率 alias_probabilities[i] で i、それ以外は alias_indices[i]」を割り当てます。
+    auto size = static_cast<int>(weights.size());
+    auto total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    this->alias_probabilities.resize(size);
+    this->alias_indices.resize(size);
+    this->small.clear();
+    this->large.clear();
+    for (int i = 0; i < size; i++)
+    {
+        // (合計が 0 の場合は一様に選択します。)
+        auto p = 0.0 < total ? weights[i] * size / total : 1.0;
+        this->alias_probabilities[i] = p;
+        this->alias_indices[i] = i;
+        (p < 1.0 ? this->small : this->large).push_back(i);
+    }
+    while (!this->small.empty() && !this->large.empty())
+    {
+        auto s = this->small.back();
+        auto l = this->large.back();
+        this->small.pop_back();
+        this->alias_indices[s] = l;
+        this->alias_probabilities[l] -= 1.0 - this->alias_probabilities[s];
+        if (this->alias_probabilities[l] < 1.0)
+        {
+            this->large.pop_back();
+            this->small.push_back(l);
+        }
+    }
+    // (丸め誤差で残った区画は、確率 1 で自身を選択します。)
+    for (auto i : this->small)
+        this->alias_probabilities[i] = 1.0;
+    for (auto i : this->large)
+        this->alias_probabilities[i] = 1.0;
+}
+
+void Selection::sort_order(int count)
+{
+    auto num_genomes = static_cast<int>(this->fitnesses.size());
+    this->order.resize(num_genomes);
+    std::iota(this->order.begin(), this->order.end(), 0);
+    auto &fitnesses = this->fitnesses;
+    auto compare = [&fitnesses](int a, int b) {
+        return is_better_fitness(fitnesses[a], fitnesses[b]) || (!is_better_fitness(fitnesses[b], fitnesses[a]) && a < b);
+    };
+    if (count < num_genomes)
+        std::nth_element(this->order.begin(), this->order.begin() + count, this->order.end(), compare);
+    std::sort(this->order.begin(), this->order.begin() + count, compare);
+    this->num_candidates = count;
+}
+}
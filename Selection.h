@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "GNPTypes.h"
+
+namespace gnp
+{
+class GNPConfig;
+class Genome;
+
+// 親個体の選択方式。
+enum class SelectionType
+{
+    Roulette,   // 適合度に比例した確率で選択します(負の適合度を含む場合は、最小値を引いた値に比例します)。
+    Tournament, // ランダムに選んだ tournament_size 個の個体のうち、適合度が最も高い個体を選択します。
+    Rank,       // 適合度の順位に対して線形な確率で選択します(最上位の重みは rank_selection_pressure、最下位は 2 - rank_selection_pressure)。
+    Truncation  // 適合度の上位 truncation_rate の割合の個体から一様に選択します。
+};
+
+// 適合度 a が b より高いかどうかを調べます(NaN は最も低いとみなします)。
+// 適合度の比較による並べ替えや選択に使用します(NaN を含む場合も狭義の弱順序になります)。
+inline bool is_better_fitness(double a, double b)
+{
+    return a > b || (std::isnan(b) && !std::isnan(a));
+}
+
+// 文字列("roulette", "tournament", "rank", "truncation")から選択方式を求めます。
+SelectionType to_selection_type(std::string name);
+
+// 選択方式を文字列に変換します。
+std::string to_string(SelectionType type);
+
+// 個体群から親個体を選択します。
+// 世代ごとに prepare で選択の表を作成した後は、select を複数のスレッドから同時に呼び出せます(select は内部状態を変更しません)。
+class Selection
+{
+  public:
+    // 各個体の適合度から選択の表を作成します。
+    // Roulette と Rank は別名法(alias method)の表を作成し、select は個体数によらず O(1) で選択します。
+    void prepare(const std::vector<Genome> &genomes, const GNPConfig &config);
+
+    // 親個体のインデックスを 1 つ選択します。
+    int select(randomizer_t &randomizer) const;
+
+  private:
+    // 確率 weights に従って選択する別名法の表を作成します(weights の合計が 0 の場合は一様に選択します)。
+    void build_alias_table(const std::vector<double> &weights);
+
+    // 適合度の高い順に並べた個体のインデックスを、上位 count 個まで order に格納します(NaN は最下位として扱います)。
+    void sort_order(int count);
+
+    SelectionType type = SelectionType::Roulette;
+    int tournament_size = 2;
+
+    // 各個体の適合度。
+    std::vector<double> fitnesses;
+
+    // 適合度の高い順に並べた個体のインデックス(Rank, Truncation)と、その中から選択する個数。
+    std::vector<int> order;
+    int num_candidates = 0;
+
+    // 別名法の表(Roulette, Rank)。alias_indices が指す先は、Rank では order の位置、Roulette では個体のインデックスです。
+    std::vector<double> alias_probabilities;
+    std::vector<int> alias_indices;
+
+    // 表の作成で使用する作業領域。
+    std::vector<double> weights;
+    std::vector<int> small;
+    std::vector<int> large;
+};
+}
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <random>
+
+#include "CompiledGenome.h"
+#include "ScopedGILRelease.h"
+#include "SteadyStateEngine.h"
+#include "ThreadPool.h"
+#include "runtime_assert.h"
+
+namespace gnp
+{
+SteadyStateEngine::SteadyStateEngine(int max_in_flight)
+    : max_in_flight(max_in_flight)
+{
+}
+
+void SteadyStateEngine::run(Population &population, const Dataset &dataset, const GNPConfig &config, const Metric &metric, long long num_evaluations, ActivationMode mode)
+{
+    runtime_assert(0 <= num_evaluations, "Number of evaluations must not be negative.");
+    auto &genomes = population.genomes;
+    auto num_genomes = static_cast<int>(genomes.size());
+    runtime_assert(0 < num_genomes, "Population is empty.");
+    metric.validate(config.output_attributes);
+
+    population.evaluate(dataset, config, metric, mode);
+    auto key = Population::evaluation_key(dataset, config, metric);
+    auto start = std::chrono::steady_clock::now();
+
+    auto threads = population.thread_pool(config);
+    if (this->workspaces.size() < threads->size())
+        this->workspaces.resize(threads->size());
+    auto num_slots = this->max_in_flight <= 0 ? threads->size() : this->max_in_flight;
+    num_slots = static_cast<int>(std::min<long long>(num_slots, num_evaluations));
+
+    // 子個体 index の乱数には、個体数ごとに 1 世代と見立てた (シード, 世代, 個体のインデックス) の系列を使用します。
+    auto first_generation = population.generation + 1;
+    auto tournament_size = std::max(config.tournament_size, 1);
+    auto dice_genome = [num_genomes](randomizer_t &randomizer) {
+        return std::uniform_int_distribution<int>(0, num_genomes - 1)(randomizer);
+    };
+
+    std::mutex mutex;
+    std::atomic<long long> next(0);
+    std::atomic<long long> num_inherited(0);
+    std::atomic<long long> num_replaced(0);
+    threads->parallel_for(0, num_slots, [&](int slot, int worker) {
+        auto &workspace = this->workspaces[worker];
+        Genome parent1;
+        Genome parent2;
+        Genome offspring;
+        for (auto index = next++; index < num_evaluations; index = next++)
+        {
+            auto randomizer = randomizer_t(population.seed, first_generation + index / num_genomes, static_cast<std::uint32_t>(index % num_genomes));
+            auto crossover = std::uniform_real_distribution<double>(0.0, 1.0)(randomizer) < config.crossover_rate;
+
+            // 親個体を一様に選択し、複製します(ノードは共有されます)。
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                parent1 = genomes[dice_genome(randomizer)];
+                if (crossover)
+                    parent2 = genomes[dice_genome(randomizer)];
+            }
+
+            if (crossover)
+            {
+                offspring.configure_crossover(randomizer, parent1, parent2, config, &workspace.pool);
+            }
+            else
+            {
+                offspring.configure_inheritance(parent1, &workspace.pool);
+                offspring.mutate(randomizer, config, &workspace.pool);
+            }
+
+            if (offspring.inherits_fitness && offspring.evaluation_key == key)
+            {
+                num_inherited++;
+            }
+            else
+            {
+                auto value = this->measure(offspring, dataset, config, metric, mode, workspace);
+                offspring.metric_value = value;
+                offspring.evaluation_key = key;
+                offspring.fitness = metric.fitness(value);
+            }
+
+            // 逆トーナメントで選んだ個体と置き換えます(置き換えた個体の領域は、次の子個体に再利用します)。
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto worst = dice_genome(randomizer);
+                for (int k = 1; k < tournament_size; k++)
+                {
+                    auto candidate = dice_genome(randomizer);
+                    if (is_better_fitness(genomes[worst].fitness, genomes[candidate].fitness))
+                        worst = candidate;
+                }
+                if (!is_better_fitness(genomes[worst].fitness, offspring.fitness))
+                {
+                    std::swap(genomes[worst], offspring);
+                    num_replaced++;
+                }
+            }
+        }
+    });
+
+    this->last_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    this->last_offsprings = num_evaluations;
+    this->offsprings += num_evaluations;
+    this->inherited += num_inherited;
+    this->replacements += num_replaced;
+
+    // 世代を進め、現在の個体のノード遷移の経路だけを残します。
+    population.generation += (num_evaluations + num_genomes - 1) / num_genomes;
+    population.judgement_cache.clear();
+    auto hashes = std::vector<std::uint64_t>(num_genomes);
+    for (int i = 0; i < num_genomes; i++)
+        hashes[i] = genomes[i].hash;
+    population.trace_cache.retain(hashes);
+}
+
+double SteadyStateEngine::measure(const Genome &genome, const Dataset &dataset, const GNPConfig &config, const Metric &metric, ActivationMode mode, Workspace &workspace) const
+{
+    auto &inputs = dataset.inputs;
+    auto &targets = dataset.targets;
+    auto num_records = static_cast<int>(inputs.rows());
+    auto stride = static_cast<int>(inputs.cols());
+    auto record_outputs = config.max_num_outputs() * static_cast<int>(config.output_attributes.size());
+    constexpr int chunk_size = CompiledGenome::chunk_size;
+    workspace.buffer.resize(chunk_size * record_outputs);
+    workspace.counts.resize(chunk_size);
+
+    auto compiled = CompiledGenome(genome, config);
+    if (mode == ActivationMode::Auto)
+        mode = compiled.select_mode(inputs.data(), num_records, stride, config);
+
+    // (区間ごとの和を足し合わせ、Population::evaluate と同じ順序で総和を計算します。)
+    auto total = 0.0;
+    for (int begin = 0; begin < num_records; begin += chunk_size)
+    {
+        auto end = std::min(begin + chunk_size, num_records);
+        compiled.activate_many(mode, inputs.row(begin).data(), end - begin, stride, config, workspace.buffer.data(), workspace.counts.data());
+        auto sum = 0.0;
+        for (int i = begin; i < end; i++)
+        {
+            auto outputs = workspace.buffer.data() + (i - begin) * record_outputs;
+            sum += metric.measure(config.output_attributes, outputs, workspace.counts[i - begin], targets.row(i).data());
+        }
+        total += sum;
+    }
+    return total / std::max(num_records, 1);
+}
+
+void SteadyStateEngine::run_py(
+    Population &population,
+    const Dataset &dataset,
+    const GNPConfig &config,
+    long long num_evaluations,
+    const std::string &metric_name,
+    const std::string &transform,
+    double scale,
+    double no_output_value,
+    const std::string &mode)
+{
+    auto metric = Metric(metric_name, transform, scale, no_output_value);
+    auto activation_mode = to_activation_mode(mode);
+    ScopedGILRelease release;
+    this->run(population, dataset, config, metric, num_evaluations, activation_mode);
+}
+
+double SteadyStateEngine::get_throughput() const
+{
+    return 0.0 < this->last_seconds ? this->last_offsprings / this->last_seconds : 0.0;
+}
+}
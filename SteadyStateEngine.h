@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/python.hpp>
+#include <boost/python/numpy.hpp>
+
+#include "ActivationMode.h"
+#include "Dataset.h"
+#include "GNPConfig.h"
+#include "GenePool.h"
+#include "Genome.h"
+#include "Metric.h"
+#include "Population.h"
+
+namespace gnp
+{
+// 世代の区切りを設けずに個体群を進化させる、定常状態(steady-state)型の進化を行います。
+// 各スレッドは 親個体の選択、子個体の生成(交叉は確率 crossover_rate、それ以外は突然変異)、子個体の評価、置き換え を繰り返し、
+// 子個体の評価が終わり次第、逆トーナメントで選んだ個体(ランダムに選んだ tournament_size 個のうち最も適合度が低い個体)と置き換えます。
+// (子個体の適合度が置き換える個体より低い場合は置き換えません。)
+// 選択圧は置き換えだけで与え、親個体は一様に選択します(親個体もトーナメントで選択すると、個体群がすぐに同じ個体で占められるためです)。
+// 個体群の参照と置き換えだけを排他的に行い、評価は並列に行うため、評価に時間がかかる個体が他のスレッドを待たせません。
+// 置き換えの順序は評価の終わる順序で決まるため、2 個以上の評価を並行して行う場合は結果が実行ごとに異なります。
+class SteadyStateEngine
+{
+  public:
+    // 同時に評価する子個体の最大数を指定して作成します(0 以下の場合はスレッド数です)。
+    explicit SteadyStateEngine(int max_in_flight = 0);
+
+    // num_evaluations 個の子個体を生成して評価し、population の個体と置き換えます。
+    // 最初に population を評価し、終了後は population.generation を 個体数 ごとに 1 世代として進めます。
+    void run(Population &population, const Dataset &dataset, const GNPConfig &config, const Metric &metric, long long num_evaluations, ActivationMode mode = ActivationMode::Auto);
+
+    // num_evaluations 個の子個体を生成して評価します(実行の間は GIL を解放します)。
+    void run_py(
+        Population &population,
+        const Dataset &dataset,
+        const GNPConfig &config,
+        long long num_evaluations,
+        const std::string &metric,
+        const std::string &transform,
+        double scale,
+        double no_output_value,
+        const std::string &mode);
+
+    // 直近の run における、1 秒あたりの子個体の生成数を取得します。
+    double get_throughput() const;
+
+  public:
+    // 同時に評価する子個体の最大数(0 以下の場合はスレッド数です)。
+    int max_in_flight;
+
+    // 生成した子個体の数(親個体の適合度を引き継いで評価を省略した個体を含みます)。
+    long long offsprings = 0;
+
+    // 親個体の適合度を引き継いで評価を省略した子個体の数。
+    long long inherited = 0;
+
+    // 個体群の個体と置き換えた子個体の数。
+    long long replacements = 0;
+
+    // 直近の run で生成した子個体の数と、その所要時間(秒)。
+    long long last_offsprings = 0;
+    double last_seconds = 0.0;
+
+  private:
+    // スレッドごとの作業領域。
+    struct Workspace
+    {
+        GenePool pool;
+        std::vector<data_t> buffer;
+        std::vector<int> counts;
+    };
+
+    // 個体をデータセット全体で評価し、評価指標の値を返します。
+    double measure(const Genome &genome, const Dataset &dataset, const GNPConfig &config, const Metric &metric, ActivationMode mode, Workspace &workspace) const;
+
+    std::vector<Workspace> workspaces;
+};
+}
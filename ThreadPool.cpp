@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <new>
+#include <string>
+#include <unordered_map>
+
+#include "ThreadPool.h"
+#include "runtime_assert.h"
+
+namespace gnp
+{
+// このスレッドが参加しているスレッドプールと、そのスレッドの番号。
+thread_local ThreadPool *current_pool = nullptr;
+thread_local int current_worker = 0;
+
+static std::shared_ptr<ThreadPool> shared_pool;
+static std::mutex shared_pool_mutex;
+
+// スレッド数を指定して取得された専用のスレッドプール(スレッド数ごとに、使用されている間だけ共有します)。
+static std::unordered_map<int, std::weak_ptr<ThreadPool>> dedicated_pools;
+
+// 既定のスレッド数(環境変数 GNP_NUM_THREADS、未設定の場合は論理コア数)を取得します。
+static int default_num_threads()
+{
+    if (auto value = std::getenv("GNP_NUM_THREADS"))
+    {
+        auto num_threads = std::atoi(value);
+        if (0 < num_threads)
+            return num_threads;
+    }
+    return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+ThreadPool::ThreadPool(int num_threads)
+{
+    runtime_assert(0 < num_threads, "Number of threads must be greater than 0.");
+    for (int i = 0; i < num_threads; i++)
+        this->queues.emplace_back(new Queue());
+    for (int i = 1; i < num_threads; i++)
+        this->threads.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->sleep_mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for (auto &thread : this->threads)
+        thread.join();
+}
+
+std::shared_ptr<ThreadPool> ThreadPool::instance()
+{
+    std::lock_guard<std::mutex> lock(shared_pool_mutex);
+    if (!shared_pool)
+        shared_pool = std::make_shared<ThreadPool>(default_num_threads());
+    return shared_pool;
+}
+
+std::shared_ptr<ThreadPool> ThreadPool::instance(int num_threads)
+{
+    auto shared = instance();
+    if (num_threads <= 0 || shared->size() == num_threads)
+        return shared;
+
+    std::lock_guard<std::mutex> lock(shared_pool_mutex);
+    auto &dedicated = dedicated_pools[num_threads];
+    auto pool = dedicated.lock();
+    if (!pool)
+    {
+        pool = std::make_shared<ThreadPool>(num_threads);
+        dedicated = pool;
+    }
+    return pool;
+}
+
+void ThreadPool::set_num_threads(int num_threads)
+{
+    if (num_threads <= 0)
+        num_threads = default_num_threads();
+
+    // (以前のスレッドプールは、保持している呼び出し元がなくなった時点でロックの外で破棄されます。)
+    std::shared_ptr<ThreadPool> previous;
+    std::lock_guard<std::mutex> lock(shared_pool_mutex);
+    if (shared_pool && shared_pool->size() == num_threads)
+        return;
+    previous = std::move(shared_pool);
+    shared_pool = std::make_shared<ThreadPool>(num_threads);
+}
+
+int ThreadPool::get_num_threads()
+{
+    return instance()->size();
+}
+
+void ThreadPool::reset_after_fork()
+{
+    // (fork の時点で他のスレッドが保持していたロックは解放されないため、ミューテックスも作り直します。)
+    // (子プロセスにはスレッドプールのスレッドが存在しないため、デストラクタで終了を待たないように参照を手放さずに残します。)
+    new (&shared_pool_mutex) std::mutex();
+    new std::shared_ptr<ThreadPool>(std::move(shared_pool));
+    for (auto &pair : dedicated_pools)
+        new std::shared_ptr<ThreadPool>(pair.second.lock());
+    dedicated_pools.clear();
+    current_pool = nullptr;
+    current_worker = 0;
+}
+
+void ThreadPool::run(Job &job, int begin, int end)
+{
+    // 待機中は、この job の区間だけを実行します。
+    // (他の job の区間を実行すると、待機中の body とスレッドごとの作業領域を共有してしまうためです。)
+    // (job は呼び出し元のスタックにあるため、finished を確認してから戻ります。)
+    auto participate = [this, &job, begin, end](int worker) {
+        this->execute({&job, begin, end}, worker);
+        while (true)
+        {
+            Range range;
+            if (0 < job.remaining.load(std::memory_order_acquire) && this->take(worker, &job, range))
+            {
+                this->execute(range, worker);
+                continue;
+            }
+
+            // (waiters を増やしてから queued を確認し、push は queued を増やしてから waiters を確認するため、通知を取りこぼしません。)
+            std::unique_lock<std::mutex> lock(job.mutex);
+            job.waiters++;
+            job.changed.wait(lock, [&job]() { return job.finished || 0 < job.queued.load(); });
+            job.waiters--;
+            if (job.finished)
+                break;
+        }
+    };
+
+    // プールのスレッドからの呼び出し(入れ子の呼び出し)は、そのスレッドの番号で参加します。
+    if (current_pool == this)
+    {
+        participate(current_worker);
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(this->external_mutex);
+        auto previous_pool = current_pool;
+        auto previous_worker = current_worker;
+        current_pool = this;
+        current_worker = 0;
+        participate(0);
+        current_pool = previous_pool;
+        current_worker = previous_worker;
+    }
+
+    if (job.error)
+        std::rethrow_exception(job.error);
+}
+
+void ThreadPool::execute(Range range, int worker)
+{
+    auto &job = *range.job;
+    if (1 < this->size())
+    {
+        while (job.grain < range.end - range.begin)
+        {
+            auto middle = range.begin + (range.end - range.begin) / 2;
+            this->push(worker, {range.job, middle, range.end});
+            range.end = middle;
+        }
+    }
+
+    try
+    {
+        job.invoke(job.body, range.begin, range.end, worker);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (!job.error)
+            job.error = std::current_exception();
+    }
+
+    // 最後の区間を終了したスレッドが、待機しているスレッドに通知します。
+    // (通知はロックを保持したまま行い、待機側が戻って job が破棄される前に終えます。)
+    auto size = range.end - range.begin;
+    if (job.remaining.fetch_sub(size, std::memory_order_acq_rel) == size)
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.finished = true;
+        job.changed.notify_all();
+    }
+}
+
+void ThreadPool::push(int worker, const Range &range)
+{
+    {
+        auto &queue = *this->queues[worker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.ranges.push_back(range);
+    }
+    this->queued.fetch_add(1, std::memory_order_release);
+
+    // 区間の終了を待っているスレッドがあれば、この区間を実行できることを通知します。
+    // (区間を積むのは job の実行中なので、job はまだ破棄されていません。)
+    auto &job = *range.job;
+    job.queued.fetch_add(1);
+    if (0 < job.waiters.load())
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.changed.notify_all();
+    }
+
+    // (待機を始める直前のスレッドが通知を取りこぼさないように、待機用のミューテックスを経由します。)
+    {
+        std::lock_guard<std::mutex> lock(this->sleep_mutex);
+    }
+    this->wake.notify_one();
+}
+
+bool ThreadPool::take(int worker, const Job *job, Range &range)
+{
+    // 自身のキューは末尾(最後に分割した小さい区間)から、他のスレッドのキューは先頭(大きい区間)から探します。
+    auto size = this->size();
+    for (int k = 0; k < size; k++)
+    {
+        auto &queue = *this->queues[(worker + k) % size];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        auto &ranges = queue.ranges;
+        auto matches = [job](const Range &range) { return !job || range.job == job; };
+        if (k == 0)
+        {
+            auto it = std::find_if(ranges.rbegin(), ranges.rend(), matches);
+            if (it == ranges.rend())
+                continue;
+            range = *it;
+            ranges.erase(std::next(it).base());
+        }
+        else
+        {
+            auto it = std::find_if(ranges.begin(), ranges.end(), matches);
+            if (it == ranges.end())
+                continue;
+            range = *it;
+            ranges.erase(it);
+        }
+        this->queued.fetch_sub(1, std::memory_order_relaxed);
+        range.job->queued.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::work(int worker)
+{
+    current_pool = this;
+    current_worker = worker;
+    while (true)
+    {
+        Range range;
+        if (this->take(worker, nullptr, range))
+        {
+            this->execute(range, worker);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(this->sleep_mutex);
+        this->wake.wait(lock, [this]() { return this->stopping || 0 < this->queued.load(std::memory_order_acquire); });
+        if (this->stopping)
+            return;
+    }
+}
+}
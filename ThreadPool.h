@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace gnp
+{
+// 作業を盗み合う(work-stealing)スレッドプールです。
+// parallel_for は区間を 2 分割しながら実行し、後半の区間を実行中のスレッドのキューに積みます。
+// 手の空いたスレッドは他のスレッドのキューの先頭(大きい区間)を盗んで実行します。
+// parallel_for を入れ子に呼び出した場合も新たなスレッドは作成せず、内側の区間も同じスレッドの集合で分担します。
+// 終了を待つスレッドは、待っている parallel_for の区間だけを実行します。
+// (個体ごとの並列処理の中でレコードごとの並列処理を行っても、スレッド数を超えて実行されることはありません。)
+class ThreadPool
+{
+  public:
+    // スレッド数(呼び出し元のスレッドを含みます)を指定してスレッドを起動します。
+    explicit ThreadPool(int num_threads);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // 全体で共有するスレッドプールを取得します。
+    // 初回の呼び出しで、環境変数 GNP_NUM_THREADS(未設定の場合は論理コア数)のスレッド数で作成されます。
+    // 並列処理を行う間は戻り値を保持します(実行中に set_num_threads が呼び出されても、保持している間は破棄されません)。
+    static std::shared_ptr<ThreadPool> instance();
+
+    // num_threads のスレッド数のスレッドプールを取得します(0 以下の場合は共有するスレッドプールです)。
+    // 共有するスレッドプールとスレッド数が異なる場合は、同じスレッド数を指定した呼び出し元の間で共有する専用のスレッドプールを返します。
+    static std::shared_ptr<ThreadPool> instance(int num_threads);
+
+    // 共有するスレッドプールのスレッド数を設定します(0 以下の場合は既定のスレッド数に戻します)。
+    // スレッド数が変わる場合だけ作り直し、実行中の並列処理はそれまでのスレッドプールで最後まで実行されます。
+    static void set_num_threads(int num_threads);
+
+    // 共有するスレッドプールのスレッド数を取得します。
+    static int get_num_threads();
+
+    // fork した子プロセスで、親プロセスから引き継いだ共有のスレッドプールを破棄します(次の instance で作り直されます)。
+    // (子プロセスには呼び出し元以外のスレッドが存在しないため、終了を待たずに手放します。)
+    static void reset_after_fork();
+
+    // スレッド数(呼び出し元のスレッドを含みます)を取得します。
+    int size() const
+    {
+        return static_cast<int>(this->queues.size());
+    }
+
+    // [begin, end) の各 i について body(i, worker) を並列に実行し、すべて終了するまで待ちます。
+    // worker は実行したスレッドの番号(0 以上 size() 未満)で、スレッドごとの作業領域の選択に使用します。
+    // 区間は grain 個以下になるまで分割されます。body が例外を送出した場合は、終了後に呼び出し元で再送出します。
+    template <typename F>
+    void parallel_for(int begin, int end, F &&body, int grain = 1);
+
+  private:
+    struct Job
+    {
+        void (*invoke)(void *body, int begin, int end, int worker);
+        void *body;
+        int grain;
+
+        // 実行が終了していない i の数。
+        std::atomic<int> remaining;
+
+        // キューに積まれているこの job の区間の数と、区間の追加または終了を待っているスレッドの数。
+        std::atomic<int> queued{0};
+        std::atomic<int> waiters{0};
+
+        // 以下は mutex で保護します。finished はすべての区間が終了したことを表し、changed で通知します。
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool finished = false;
+        std::exception_ptr error;
+    };
+
+    struct Range
+    {
+        Job *job;
+        int begin;
+        int end;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    // 区間を実行します(grain 個を超える区間は後半をキューに積みながら分割します)。
+    void execute(Range range, int worker);
+
+    // job のすべての区間が終了するまで、キューの区間を実行しながら待ちます。
+    // 実行できる区間がない間は、区間が追加されるか job が終了するまで待機します。
+    void run(Job &job, int begin, int end);
+
+    void push(int worker, const Range &range);
+
+    // 自身のキューの末尾、または他のスレッドのキューの先頭から job の区間を取り出します(job が nullptr の場合はすべての区間が対象です)。
+    bool take(int worker, const Job *job, Range &range);
+
+    void work(int worker);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    std::vector<std::thread> threads;
+
+    // キューに積まれている区間の数。
+    std::atomic<long> queued{0};
+
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    // プール外のスレッドから parallel_for を呼び出す場合は、1 度に 1 つのスレッドだけが番号 0 として参加します。
+    std::mutex external_mutex;
+};
+
+template <typename F>
+void ThreadPool::parallel_for(int begin, int end, F &&body, int grain)
+{
+    if (end <= begin)
+        return;
+
+    typedef typename std::remove_reference<F>::type body_t;
+    Job job;
+    job.invoke = [](void *body, int begin, int end, int worker) {
+        auto &f = *static_cast<body_t *>(body);
+        for (int i = begin; i < end; i++)
+            f(i, worker);
+    };
+    job.body = const_cast<void *>(static_cast<const void *>(&body));
+    job.grain = std::max(grain, 1);
+    job.remaining.store(end - begin);
+    this->run(job, begin, end);
+}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+
+#include "GNPTypes.h"
+
+namespace gnp
+{
+// しきい値の個数が max_count_search_size 以下の場合は比較結果の数え上げを、max_scan_search_size 以下の場合は先頭からの走査を、
+// それより多い場合は二分探索を使用します(benchmarks/threshold_search の計測結果から決めた値です)。
+constexpr int max_count_search_size = 16;
+constexpr int max_scan_search_size = 128;
+
+static inline numeric_t to_numeric(numeric_t value)
+{
+    return value;
+}
+
+static inline numeric_t to_numeric(data_t value)
+{
+    return value.numeric;
+}
+
+// 昇順に並んだしきい値のうち value < thresholds[i] となる最小の i (存在しなければ size)を求めます。
+// 全てのしきい値と比較して数え上げるため分岐がなく、ベクトル化されます。
+// (value が NaN の場合は比較が常に偽となるため、size を返します。)
+template <typename T>
+inline int count_search(const T *thresholds, int size, numeric_t value)
+{
+    // 注; 数え上げる変数を numeric_t と同じ幅の整数型にしないとベクトル化されない
+    category_t index = 0;
+#pragma omp simd reduction(+ : index)
+    for (int i = 0; i < size; i++)
+        index += value < to_numeric(thresholds[i]) ? 0 : 1;
+    return static_cast<int>(index);
+}
+
+// count_search と同じ結果を、先頭から順に比較して最初に value < thresholds[i] となる位置で打ち切って求めます。
+template <typename T>
+inline int scan_search(const T *thresholds, int size, numeric_t value)
+{
+    int index = 0;
+    while (index < size && !(value < to_numeric(thresholds[index])))
+        index++;
+    return index;
+}
+
+// count_search と同じ結果を二分探索で求めます。
+template <typename T>
+inline int binary_search(const T *thresholds, int size, numeric_t value)
+{
+    auto it = std::partition_point(thresholds, thresholds + size, [value](const T &threshold) {
+        return !(value < to_numeric(threshold));
+    });
+    return static_cast<int>(it - thresholds);
+}
+
+// 数値属性の判定ノードにおけるブランチのインデックスを求めます(しきい値の個数に応じて探索方法を選択します)。
+template <typename T>
+inline int search_branch(const T *thresholds, int size, numeric_t value)
+{
+    if (size <= max_count_search_size)
+        return count_search(thresholds, size, value);
+    else if (size <= max_scan_search_size)
+        return scan_search(thresholds, size, value);
+    else
+        return binary_search(thresholds, size, value);
+}
+
+// 複数の値 values に対して search_branch と同じ結果を求め、branches に格納します。
+// しきい値が少ない場合は、しきい値ごとに全ての値と比較して数え上げるため、値の方向にベクトル化されます。
+template <typename T>
+inline void search_branches(const T *thresholds, int size, const numeric_t *values, int num_values, category_t *branches)
+{
+    if (size <= max_count_search_size)
+    {
+        std::fill(branches, branches + num_values, 0);
+        for (int j = 0; j < size; j++)
+        {
+            auto threshold = to_numeric(thresholds[j]);
+#pragma omp simd
+            for (int i = 0; i < num_values; i++)
+                branches[i] += values[i] < threshold ? 0 : 1;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < num_values; i++)
+            branches[i] = search_branch(thresholds, size, values[i]);
+    }
+}
+}
@@ -0,0 +1,119 @@
+#include <unordered_set>
+
+#include "TraceCache.h"
+
+namespace gnp
+{
+void TraceCache::prepare(std::uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->key != key)
+    {
+        this->entries.clear();
+        this->index.clear();
+        this->bytes = 0;
+        this->key = key;
+    }
+}
+
+TraceCache::trace_t TraceCache::get(std::uint64_t hash)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = this->index.find(hash);
+    if (it == this->index.end())
+    {
+        this->misses++;
+        return nullptr;
+    }
+    this->hits++;
+    this->entries.splice(this->entries.begin(), this->entries, it->second);
+    return it->second->second;
+}
+
+void TraceCache::put(std::uint64_t hash, trace_t trace)
+{
+    auto size = trace->bytes();
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->max_bytes < size)
+        return;
+    auto it = this->index.find(hash);
+    if (it != this->index.end())
+    {
+        this->bytes -= it->second->second->bytes();
+        this->entries.erase(it->second);
+        this->index.erase(it);
+    }
+    this->entries.emplace_front(hash, std::move(trace));
+    this->index.emplace(hash, this->entries.begin());
+    this->bytes += size;
+    this->evict();
+}
+
+void TraceCache::retain(const std::vector<std::uint64_t> &hashes)
+{
+    auto retained = std::unordered_set<std::uint64_t>(hashes.begin(), hashes.end());
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (auto it = this->entries.begin(); it != this->entries.end();)
+    {
+        if (retained.count(it->first))
+        {
+            ++it;
+            continue;
+        }
+        this->bytes -= it->second->bytes();
+        this->index.erase(it->first);
+        it = this->entries.erase(it);
+    }
+}
+
+void TraceCache::clear()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->entries.clear();
+    this->index.clear();
+    this->bytes = 0;
+    this->key = 0;
+}
+
+void TraceCache::reset_statistics()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->hits = 0;
+    this->misses = 0;
+}
+
+long long TraceCache::get_hits() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->hits;
+}
+
+long long TraceCache::get_misses() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->misses;
+}
+
+int TraceCache::get_size() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return static_cast<int>(this->entries.size());
+}
+
+long long TraceCache::get_bytes() const
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->bytes;
+}
+
+void TraceCache::evict()
+{
+    while (this->max_bytes < this->bytes && !this->entries.empty())
+    {
+        auto &entry = this->entries.back();
+        this->bytes -= entry.second->bytes();
+        this->index.erase(entry.first);
+        this->entries.pop_back();
+    }
+}
+}
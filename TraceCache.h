@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace gnp
+{
+// 個体を評価したときの、ノード遷移の経路と各レコードの評価指標の値です。
+struct ActivationTrace
+{
+    // ノードごとのビット集合の要素数((レコード数 + 63) / 64)。
+    int words = 0;
+
+    // 各ノードを実行したレコードのビット集合(ノード n を実行したレコード i は visits[n * words + i / 64] の i % 64 ビット目)。
+    std::vector<std::uint64_t> visits;
+
+    // 各レコードの評価指標の値(平均を取る前の値)。
+    std::vector<double> losses;
+
+    long long bytes() const
+    {
+        return static_cast<long long>(this->visits.size() * sizeof(std::uint64_t) + this->losses.size() * sizeof(double));
+    }
+};
+
+// 個体のハッシュ値からノード遷移の経路を引くキャッシュです。
+// 子個体の評価では、親個体の経路から変更されたノードを実行したレコードだけを再評価します。
+// 合計バイト数が上限を超えた場合は、最も長く使われていない経路から破棄されます。
+class TraceCache
+{
+  public:
+    typedef std::shared_ptr<const ActivationTrace> trace_t;
+
+    TraceCache() = default;
+
+    // (複製では内容を引き継ぎません。)
+    TraceCache(const TraceCache &)
+    {
+    }
+
+    TraceCache &operator=(const TraceCache &)
+    {
+        this->clear();
+        return *this;
+    }
+
+    // 評価の設定のハッシュ値が前回と異なる場合は、キャッシュを破棄します。
+    void prepare(std::uint64_t key);
+
+    // 個体のハッシュ値に対応する経路を取得します(ない場合は nullptr を返します)。
+    trace_t get(std::uint64_t hash);
+
+    // 個体のハッシュ値に対応する経路を登録します。
+    void put(std::uint64_t hash, trace_t trace);
+
+    // 指定された個体の経路だけを残します(世代の更新で、親個体として選択された個体を指定します)。
+    void retain(const std::vector<std::uint64_t> &hashes);
+
+    // キャッシュを破棄します(統計情報は保持されます)。
+    void clear();
+
+    // 統計情報を初期化します。
+    void reset_statistics();
+
+    long long get_hits() const;
+
+    long long get_misses() const;
+
+    // 登録されている経路の数を取得します。
+    int get_size() const;
+
+    // 登録されている経路の合計バイト数を取得します。
+    long long get_bytes() const;
+
+  public:
+    // 登録する経路の合計バイト数の上限(0 の場合は経路を記録しません)。
+    long long max_bytes = 256LL << 20;
+
+  private:
+    typedef std::list<std::pair<std::uint64_t, trace_t>> entries_t;
+
+    // 合計バイト数が上限以下になるまで経路を破棄します(ロックを取得してから呼び出します)。
+    void evict();
+
+    mutable std::mutex mutex;
+
+    // 最近使われた順に並べた経路。
+    entries_t entries;
+
+    std::unordered_map<std::uint64_t, entries_t::iterator> index;
+
+    std::uint64_t key = 0;
+
+    long long hits = 0;
+
+    long long misses = 0;
+
+    long long bytes = 0;
+};
+}
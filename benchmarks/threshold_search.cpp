@@ -0,0 +1,60 @@
+// 数値属性の判定ノードにおけるブランチ探索のマイクロベンチマーク。
+// make benchmarks でビルドし、./benchmarks/threshold_search で実行します。
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "../ThresholdSearch.h"
+
+using namespace gnp;
+
+template <typename F>
+static double measure(F search, const std::vector<numeric_t> &thresholds, const std::vector<numeric_t> &values, long long &checksum)
+{
+    constexpr int repeat = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++)
+    {
+        for (auto value : values)
+            checksum += search(thresholds.data(), thresholds.size(), value);
+    }
+    auto end = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration<double, std::nano>(end - start).count();
+    return elapsed / (static_cast<double>(repeat) * values.size());
+}
+
+int main()
+{
+    std::mt19937_64 randomizer(0);
+    std::uniform_real_distribution<numeric_t> distribution(0, 1);
+
+    std::vector<numeric_t> values(1 << 20);
+    for (auto &value : values)
+        value = distribution(randomizer);
+
+    std::printf("%8s %12s %12s %12s %12s\n", "size", "scan[ns]", "count[ns]", "binary[ns]", "auto[ns]");
+    for (int size : {1, 2, 4, 8, 16, 32, 64, 128, 256, 512})
+    {
+        std::vector<numeric_t> thresholds(size);
+        for (auto &threshold : thresholds)
+            threshold = distribution(randomizer);
+        std::sort(thresholds.begin(), thresholds.end());
+
+        long long scan_sum = 0, count_sum = 0, binary_sum = 0, auto_sum = 0;
+        auto scan_time = measure(scan_search<numeric_t>, thresholds, values, scan_sum);
+        auto count_time = measure(count_search<numeric_t>, thresholds, values, count_sum);
+        auto binary_time = measure(binary_search<numeric_t>, thresholds, values, binary_sum);
+        auto auto_time = measure(search_branch<numeric_t>, thresholds, values, auto_sum);
+
+        if (scan_sum != count_sum || scan_sum != binary_sum || scan_sum != auto_sum)
+        {
+            std::fprintf(stderr, "Search results differ (size = %d).\n", size);
+            return 1;
+        }
+        std::printf("%8d %12.2f %12.2f %12.2f %12.2f\n", size, scan_time, count_time, binary_time, auto_time);
+    }
+    return 0;
+}
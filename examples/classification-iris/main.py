@@ -19,6 +19,10 @@ def main():
     inputs = dataset.data
     outputs = dataset.target
 
+    # (データセットを 1 度だけ C++ 側の形式に変換しておきます。)
+    training_set = gnp.Dataset(inputs, config.input_attributes,
+                               outputs, config.output_attributes)
+
     # (ワーキングディレクトリを移動します。)
     directory = "results"
     os.mkdir(directory) if not os.path.isdir(directory) else None
@@ -36,20 +40,10 @@ def main():
     # 遺伝的ネットワークプログラミングの学習を行います。
     for generation in range(100):
 
-        # 個体の適合度を決定する評価関数。
-        def evaluate(genome):
-            num_corrects = 0
-            for input, output in zip(inputs, outputs):
-                estimation = genome.activate(input, config)
-                if 0 < len(estimation):
-                    if float(estimation) == output:
-                        num_corrects += 1
-            accuracy = num_corrects / len(outputs)
-            return accuracy
-
-        # 個体の適合度を計算します。
-        for genome in population.genomes:
-            genome.fitness = evaluate(genome)
+        # 全個体の適合度(正解率)を計算します。
+        # (処理ノードを通らなかった場合、不正解とみなします。)
+        population.evaluate(training_set, config,
+                            metric='accuracy', no_output_value=-1)
 
         # (全個体の適合度を変数に保存します。)
         fitnesses.append([])
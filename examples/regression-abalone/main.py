@@ -5,7 +5,6 @@ import matplotlib.pylab as plt
 import numpy as np
 import pydotplus
 import pandas as pd
-import math
 
 import gnp
 
@@ -25,6 +24,10 @@ def main():
     inputs = dataframe.values[:, 0:8]
     outputs = dataframe.values[:, 8]
 
+    # (データセットを 1 度だけ C++ 側の形式に変換しておきます。)
+    training_set = gnp.Dataset(inputs, config.input_attributes,
+                               outputs, config.output_attributes)
+
     # (ワーキングディレクトリを移動します。)
     directory = "results"
     os.mkdir(directory) if not os.path.isdir(directory) else None
@@ -43,40 +46,18 @@ def main():
     # 遺伝的ネットワークプログラミングの学習を行います。
     for generation in range(100):
 
-        # 平均二乗誤差。
-        def mean_squared_error(x, y):
-            error = 0.
-            assert len(x) == len(y)
-            for a, b in zip(x, y):
-                error += (a - b) ** 2
-            return error / len(x)
-
-        # 個体の適合度を計算するために必要な損失値を計算する関数。
+        # 全個体の損失値(平均二乗誤差)と適合度を計算します。
         # (処理ノードを通らなかった場合、強制的に '0' を出力したとみなします。)
-        def loss(genome):
-            estimations = []
-            for input, output in zip(inputs, outputs):
-                estimation = genome.activate(input, config)
-                estimation = float(estimation) if 0 < len(estimation) else 0
-                estimations.append(estimation)
-            return mean_squared_error(estimations, outputs)
-
-        # 個体の適合度を決定する評価関数。
-        # (適合度は、 0~1 の範囲に収まるように、適当にスケーリングします。)
-        def evaluate(genome):
-            fitness = -math.log(loss(genome) / 10000)
-            return fitness
-
-        # 個体の適合度を計算します。
-        for genome in population.genomes:
-            genome.fitness = evaluate(genome)
+        # (適合度は、 -log(損失値 / 10000) として適当にスケーリングします。)
+        genome_losses = population.evaluate(
+            training_set, config, metric='mse',
+            transform='negative_log', scale=10000, no_output_value=0)
 
         # (全個体の適合度と損失値を変数に保存します。)
         fitnesses.append([])
-        losses.append([])
         for genome in population.genomes:
             fitnesses[-1].append(genome.fitness)
-            losses[-1].append(loss(genome))
+        losses.append(list(genome_losses))
 
         # (現世代の適合度の最大値や平均値を表示します。)
         best = np.max(fitnesses[-1])
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace gnp
+{
+// ハッシュ値 seed に値 value を混ぜ合わせます(混合には splitmix64 の最終化関数を使用します)。
+inline std::uint64_t hash_combine(std::uint64_t seed, std::uint64_t value)
+{
+    auto x = seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// 値のビット列を整数として取得します(8 バイト以下の型に限ります)。
+template <typename T>
+inline std::uint64_t hash_bits(T value)
+{
+    static_assert(sizeof(T) <= sizeof(std::uint64_t), "");
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(T));
+    return bits;
+}
+
+// 浮動小数点数のビット列を整数として取得します(0.0 と -0.0 は同じ値になります)。
+template <typename T>
+inline std::uint64_t hash_floating(T value)
+{
+    return value == 0 ? 0 : hash_bits(value);
+}
+}
@@ -0,0 +1,43 @@
+import os
+
+from sklearn import datasets
+
+import gnp
+
+
+def evolve(config, inputs, outputs):
+
+    # シードを指定した島モデルを、複数のスレッドで進化させます。
+    islands = gnp.IslandPopulation(config, 4, migration_interval=5, num_migrants=2)
+    islands.evolve(inputs, outputs, 30, metric='accuracy', no_output_value=-1)
+
+    # (各島の個体のハッシュ値と適合度、統計情報を返します。)
+    genomes = []
+    statistics = []
+    for i in range(islands.num_islands):
+        genomes.append([(genome.hash, genome.fitness) for genome in islands.island(i).genomes])
+        s = islands.statistics[i]
+        statistics.append((s.generation, s.best_fitness, s.mean_fitness, s.migrants_sent, s.migrants_received))
+    return genomes, statistics
+
+
+def main():
+
+    config = gnp.GNPConfig('../examples/classification-iris/gnp-config.json')
+    config.seed = 42
+    config.num_threads = 4
+
+    dataset = datasets.load_iris()
+    inputs = dataset.data
+    outputs = dataset.target
+
+    # 同じシードであれば、移住を含めて同じ結果になることを確認します。
+    first = evolve(config, inputs, outputs)
+    second = evolve(config, inputs, outputs)
+    assert first == second, 'Island model is not reproducible with the same seed.'
+    print('ok')
+
+
+if __name__ == '__main__':
+    os.chdir(os.path.dirname(os.path.abspath(__file__)))
+    main()
@@ -0,0 +1,68 @@
+import os
+
+from sklearn import datasets
+
+import gnp
+
+
+def snapshot(population):
+
+    # (個体のハッシュ値と適合度を返します。)
+    return [(genome.hash, genome.fitness) for genome in population.genomes]
+
+
+def run(config, dataset):
+
+    # 評価と世代の更新を Python 側で繰り返します。
+    population = gnp.Population(config)
+    for generation in range(20):
+        population.evaluate(dataset, config, metric='accuracy', no_output_value=-1)
+        population.run(config)
+    population.evaluate(dataset, config, metric='accuracy', no_output_value=-1)
+    return snapshot(population)
+
+
+def evolve(config, dataset):
+
+    # 評価と世代の更新を C++ 側で繰り返します。
+    population = gnp.Population(config)
+    history = population.evolve(dataset, config, 20, metric='accuracy', no_output_value=-1)
+
+    # (経過時間は除きます。)
+    statistics = [(s.generation, s.best_fitness, s.mean_fitness, s.best_metric_value) for s in history]
+    return snapshot(population), statistics
+
+
+def evolve_islands(config, inputs, outputs):
+
+    # 島モデルで進化させます(移住を含みます)。
+    islands = gnp.IslandPopulation(config, 4, migration_interval=5, num_migrants=2)
+    islands.evolve(inputs, outputs, 20, metric='accuracy', no_output_value=-1)
+    return [snapshot(islands.island(i)) for i in range(islands.num_islands)]
+
+
+def main():
+
+    config = gnp.GNPConfig('../examples/classification-iris/gnp-config.json')
+    config.seed = 42
+
+    dataset = datasets.load_iris()
+    inputs = dataset.data
+    outputs = dataset.target
+    training_set = gnp.Dataset(inputs, config.input_attributes, outputs, config.output_attributes)
+
+    # 同じシードであれば、スレッド数によらず同じ個体群になることを確認します。
+    results = []
+    for num_threads in [1, 4]:
+        config.num_threads = num_threads
+        results.append((run(config, training_set), evolve(config, training_set), evolve_islands(config, inputs, outputs)))
+    single, multiple = results
+    assert single[0] == multiple[0], 'Population.run depends on the number of threads.'
+    assert single[1] == multiple[1], 'Population.evolve depends on the number of threads.'
+    assert single[2] == multiple[2], 'Island model depends on the number of threads.'
+    print('ok')
+
+
+if __name__ == '__main__':
+    os.chdir(os.path.dirname(os.path.abspath(__file__)))
+    main()